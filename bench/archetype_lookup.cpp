@@ -0,0 +1,87 @@
+// spawn_with() cost against the number of archetypes in the registry. The
+// target archetype is found by hashing its signature, so the cost per
+// entity should stay flat as unrelated archetypes pile up.
+//
+// Usage: bench_archetype_lookup [entity_count], defaulting to 100k.
+
+#include <bench/bench.hpp>
+#include <cstdint>
+#include <cstdio>
+#include <kata/ecs/registry.hpp>
+#include <utility>
+#include <vector>
+
+using namespace kata;
+
+struct Position {
+    float x {};
+    float y {};
+    float z {};
+};
+
+struct Velocity {
+    float x {};
+    float y {};
+    float z {};
+};
+
+// Distinct component types to build unrelated archetypes from.
+template<size_t N>
+struct Marker {
+    uint32_t value {};
+};
+
+static constexpr size_t marker_count = 12;
+static constexpr int repetitions = 5;
+
+// Creates the archetype {Position, Marker<i> for every bit i of `mask`}.
+static void create_archetype(Registry& reg, uint32_t mask)
+{
+    auto id = reg.spawn_with(Position {});
+
+    [&]<size_t... I>(std::index_sequence<I...>) {
+        ([&] {
+            if (mask & (1u << I)) {
+                reg.add_component(id, Marker<I> {});
+            }
+        }(),
+            ...);
+    }(std::make_index_sequence<marker_count> {});
+}
+
+int main(int argc, char** argv)
+{
+    auto entity_count = bench::size_argument(argc, argv, 1, 100'000);
+
+    std::printf("%12s %16s %18s\n", "archetypes", "spawn ns/entity", "despawn ns/entity");
+
+    for (uint32_t bits : { 0u, 4u, 8u, 12u }) {
+        Registry reg;
+
+        for (uint32_t mask = 0; mask < (1u << bits); mask++) {
+            create_archetype(reg, mask);
+        }
+
+        std::vector<EntityID> ids(entity_count);
+        double spawn = INFINITY;
+        double despawn = INFINITY;
+
+        // Spawning and despawning alternate, so every round spawns into
+        // recycled rows and indices.
+        for (int i = 0; i < repetitions; i++) {
+            spawn = std::min(spawn, bench::best_time(1, [&] {
+                for (auto& id : ids) {
+                    id = reg.spawn_with(Position {}, Velocity {});
+                }
+            }));
+
+            despawn = std::min(despawn, bench::best_time(1, [&] {
+                for (auto id : ids) {
+                    reg.despawn(id);
+                }
+            }));
+        }
+
+        std::printf("%12zu %16.1f %18.1f\n", reg.query_cache<Entity>().archetype_count(), spawn / entity_count, despawn / entity_count);
+    }
+}
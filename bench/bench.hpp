@@ -0,0 +1,33 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdlib>
+
+// Helpers shared by the benchmark executables.
+namespace kata::bench {
+// Best of `repetitions` runs of f(), in nanoseconds.
+template<typename F>
+double best_time(int repetitions, F f)
+{
+    auto best = double(INFINITY);
+
+    for (int i = 0; i < repetitions; i++) {
+        auto start = std::chrono::steady_clock::now();
+        f();
+        auto end = std::chrono::steady_clock::now();
+
+        best = std::min(best, std::chrono::duration<double, std::nano>(end - start).count());
+    }
+
+    return best;
+}
+
+// The `index`-th command line argument as a number, or `fallback`.
+inline size_t size_argument(int argc, char** argv, int index, size_t fallback)
+{
+    return index < argc ? size_t(std::strtoull(argv[index], nullptr, 10)) : fallback;
+}
+}
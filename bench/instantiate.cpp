@@ -0,0 +1,106 @@
+// Prefab instantiation: instantiate() against spawning the same components
+// per entity, and wave churn (instantiate a wave, despawn it, repeat) to
+// show that recycled indices keep the index space bounded.
+//
+// Usage: bench_instantiate [entity_count] [waves], defaulting to 100k
+// entities and 1000 waves of 1000.
+
+#include <algorithm>
+#include <bench/bench.hpp>
+#include <cstdint>
+#include <cstdio>
+#include <kata/ecs/registry.hpp>
+#include <string>
+#include <tuple>
+#include <utility>
+
+using namespace kata;
+
+struct Position {
+    float x {};
+    float y {};
+    float z {};
+};
+
+struct Velocity {
+    float x {};
+    float y {};
+    float z {};
+};
+
+struct Lifetime {
+    float seconds {};
+};
+
+// Not trivially copyable, so it's copy constructed rather than memcpy'd.
+struct Name {
+    std::string value {};
+};
+
+static constexpr int repetitions = 5;
+static constexpr size_t wave_size = 1000;
+
+// Best time of `spawn(reg, prefab)` into a fresh registry holding only the
+// prefab, in nanoseconds.
+template<typename F>
+static double time_spawn(F spawn)
+{
+    auto best = double(INFINITY);
+
+    for (int i = 0; i < repetitions; i++) {
+        Registry reg;
+        auto prefab = reg.spawn_with(Position {}, Velocity { 0, 1, 0 }, Lifetime { 2.0f }, Name { "spark particle" }, Prefab {});
+
+        best = std::min(best, bench::best_time(1, [&] {
+            spawn(reg, prefab);
+        }));
+    }
+
+    return best;
+}
+
+int main(int argc, char** argv)
+{
+    auto entity_count = bench::size_argument(argc, argv, 1, 100'000);
+    auto waves = bench::size_argument(argc, argv, 2, 1000);
+
+    auto per_entity = time_spawn([&](Registry& reg, EntityID prefab) {
+        for (size_t i = 0; i < entity_count; i++) {
+            reg.spawn_with(reg.get<Position const>(prefab), reg.get<Velocity const>(prefab), reg.get<Lifetime const>(prefab), reg.get<Name const>(prefab));
+        }
+    });
+
+    auto batch = time_spawn([&](Registry& reg, EntityID prefab) {
+        reg.spawn_batch<Position, Velocity, Lifetime, Name>(entity_count, [&](size_t) {
+            return std::tuple { reg.get<Position const>(prefab), reg.get<Velocity const>(prefab), reg.get<Lifetime const>(prefab), reg.get<Name const>(prefab) };
+        });
+    });
+
+    auto instantiate = time_spawn([&](Registry& reg, EntityID prefab) {
+        reg.instantiate(prefab, entity_count);
+    });
+
+    std::printf("%zu copies of a prefab\n", entity_count);
+    std::printf("%-20s %10s %14s %8s\n", "", "ms", "ns/entity", "speedup");
+
+    for (auto [name, ns] : { std::pair { "spawn_with() loop", per_entity }, std::pair { "spawn_batch()", batch }, std::pair { "instantiate()", instantiate } }) {
+        std::printf("%-20s %10.2f %14.1f %8.2f\n", name, ns / 1e6, ns / entity_count, per_entity / ns);
+    }
+
+    Registry reg;
+    auto prefab = reg.spawn_with(Position {}, Velocity { 0, 1, 0 }, Lifetime { 2.0f }, Name { "spark particle" }, Prefab {});
+    uint32_t index_end = 0;
+
+    auto churn = bench::best_time(1, [&] {
+        for (size_t wave = 0; wave < waves; wave++) {
+            auto ids = reg.instantiate(prefab, wave_size);
+
+            for (auto id : ids) {
+                index_end = std::max(index_end, entity_index(id) + 1);
+                reg.despawn(id);
+            }
+        }
+    });
+
+    std::printf("%zu waves of %zu: %.1f us per wave, index space %u\n", waves, wave_size, churn / waves / 1e3, index_end);
+}
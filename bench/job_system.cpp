@@ -0,0 +1,93 @@
+// Job system overhead and throughput for 0 to N workers:
+//
+//   submit:       empty jobs submitted from the main thread, ns per job
+//   steal:        empty jobs submitted from inside one job, so other threads
+//                 have to steal them, ns per job
+//   parallel_for: a compute-bound loop, items per second and speedup over
+//                 0 workers
+//
+// Usage: bench_job_system [max_workers], defaulting to one worker per
+// hardware thread besides the main thread.
+
+#include <algorithm>
+#include <bench/bench.hpp>
+#include <cmath>
+#include <cstdio>
+#include <kata/core/job_system.hpp>
+#include <thread>
+#include <vector>
+
+using namespace kata;
+
+static constexpr size_t job_count = 100'000;
+static constexpr size_t item_count = size_t(1) << 22;
+static constexpr size_t grain_size = 16 * 1024;
+static constexpr int repetitions = 5;
+
+static double submit_ns(JobSystem& jobs)
+{
+    return bench::best_time(repetitions, [&] {
+        JobCounter counter {};
+
+        for (size_t i = 0; i < job_count; i++) {
+            jobs.submit(counter, [] { });
+        }
+
+        jobs.wait(counter);
+    }) / job_count;
+}
+
+static double steal_ns(JobSystem& jobs)
+{
+    return bench::best_time(repetitions, [&] {
+        JobCounter root {};
+
+        jobs.submit(root, [&] {
+            JobCounter children {};
+
+            for (size_t i = 0; i < job_count; i++) {
+                jobs.submit(children, [] { });
+            }
+
+            jobs.wait(children);
+        });
+
+        jobs.wait(root);
+    }) / job_count;
+}
+
+static double parallel_for_ns(JobSystem& jobs, std::vector<float>& items)
+{
+    return bench::best_time(repetitions, [&] {
+        jobs.parallel_for(items.size(), grain_size, [&](size_t begin, size_t end) {
+            for (auto i = begin; i < end; i++) {
+                items[i] = std::sqrt(items[i] * 1.0001f + 1.0f);
+            }
+        });
+    });
+}
+
+int main(int argc, char** argv)
+{
+    auto max_workers = bench::size_argument(argc, argv, 1, std::max(std::thread::hardware_concurrency(), 1u) - 1);
+
+    std::vector<float> items(item_count, 1.0f);
+    double serial_ns = 0;
+
+    std::printf("hardware threads: %u\n", std::thread::hardware_concurrency());
+    std::printf("%8s %12s %12s %16s %8s\n", "workers", "submit ns", "steal ns", "parallel_for M/s", "speedup");
+
+    for (size_t workers = 0; workers <= max_workers; workers++) {
+        JobSystem jobs(workers);
+
+        auto submit = submit_ns(jobs);
+        auto steal = steal_ns(jobs);
+        auto loop = parallel_for_ns(jobs, items);
+
+        if (workers == 0) {
+            serial_ns = loop;
+        }
+
+        std::printf("%8zu %12.1f %12.1f %16.1f %8.2f\n", workers, submit, steal, item_count / loop * 1e3, serial_ns / loop);
+    }
+}
@@ -0,0 +1,68 @@
+// par_query() scaling: one registry per worker count, each on its own
+// JobSystem, iterating the same entities with query() and par_query().
+// Reports ns per row and the speedup of par_query() over query().
+//
+// Usage: bench_par_query [max_workers] [entity_count], defaulting to one
+// worker per hardware thread besides the main thread and 1M entities.
+
+#include <algorithm>
+#include <bench/bench.hpp>
+#include <cmath>
+#include <cstdio>
+#include <kata/core/job_system.hpp>
+#include <kata/ecs/registry.hpp>
+#include <thread>
+#include <tuple>
+
+using namespace kata;
+
+struct Position {
+    float x {};
+    float y {};
+    float z {};
+};
+
+struct Velocity {
+    float x {};
+    float y {};
+    float z {};
+};
+
+static constexpr int repetitions = 10;
+
+// A little more than a plain integration step, so the loop isn't entirely
+// bound by memory bandwidth.
+static void step(Position& position, Velocity const& velocity)
+{
+    position.x += velocity.x * 0.016f;
+    position.y += velocity.y * 0.016f;
+    position.z = std::sin(position.z + velocity.z);
+}
+
+int main(int argc, char** argv)
+{
+    auto max_workers = bench::size_argument(argc, argv, 1, std::max(std::thread::hardware_concurrency(), 1u) - 1);
+    auto entity_count = bench::size_argument(argc, argv, 2, 1'000'000);
+
+    std::printf("hardware threads: %u, entities: %zu\n", std::thread::hardware_concurrency(), entity_count);
+    std::printf("%8s %14s %18s %8s\n", "workers", "query ns/row", "par_query ns/row", "speedup");
+
+    for (size_t workers = 0; workers <= max_workers; workers++) {
+        JobSystem jobs(workers);
+        Registry reg(jobs);
+
+        reg.spawn_batch<Position, Velocity>(entity_count, [](size_t i) {
+            return std::tuple { Position { float(i), 0, 0 }, Velocity { 1, 2, 3 } };
+        });
+
+        auto serial = bench::best_time(repetitions, [&] {
+            reg.query<Position, Velocity const>(step);
+        });
+
+        auto parallel = bench::best_time(repetitions, [&] {
+            reg.par_query<Position, Velocity const>(step);
+        });
+
+        std::printf("%8zu %14.2f %18.2f %8.2f\n", workers, serial / entity_count, parallel / entity_count, serial / parallel);
+    }
+}
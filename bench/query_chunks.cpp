@@ -0,0 +1,110 @@
+// query_chunks() against query(): the same position += velocity * dt step
+// as a per-row callback, as a scalar loop over each chunk's columns and
+// as an SSE/AVX kernel over each chunk's columns.
+//
+// Usage: bench_query_chunks [entity_count], defaulting to 1M.
+
+#include <bench/bench.hpp>
+#include <cstdio>
+#include <kata/ecs/registry.hpp>
+#include <span>
+#include <tuple>
+
+#if defined(__SSE__) || defined(__AVX__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define BENCH_HAS_SSE 1
+#include <immintrin.h>
+#endif
+
+using namespace kata;
+
+struct Position {
+    float x {};
+    float y {};
+    float z {};
+};
+
+struct Velocity {
+    float x {};
+    float y {};
+    float z {};
+};
+
+static constexpr int repetitions = 10;
+static constexpr float dt = 1.0f / 60.0f;
+
+static void integrate_scalar(std::span<Position> positions, std::span<Velocity const> velocities)
+{
+    auto p = reinterpret_cast<float*>(positions.data());
+    auto v = reinterpret_cast<float const*>(velocities.data());
+    auto count = positions.size() * 3;
+
+    for (size_t i = 0; i < count; i++) {
+        p[i] += v[i] * dt;
+    }
+}
+
+static void integrate_simd(std::span<Position> positions, std::span<Velocity const> velocities)
+{
+    auto p = reinterpret_cast<float*>(positions.data());
+    auto v = reinterpret_cast<float const*>(velocities.data());
+    auto count = positions.size() * 3;
+    size_t i = 0;
+
+#if defined(__AVX__)
+    auto dt8 = _mm256_set1_ps(dt);
+    for (; i + 8 <= count; i += 8) {
+        _mm256_store_ps(p + i, _mm256_add_ps(_mm256_load_ps(p + i), _mm256_mul_ps(_mm256_load_ps(v + i), dt8)));
+    }
+#endif
+
+#if defined(BENCH_HAS_SSE)
+    auto dt4 = _mm_set1_ps(dt);
+    for (; i + 4 <= count; i += 4) {
+        _mm_store_ps(p + i, _mm_add_ps(_mm_load_ps(p + i), _mm_mul_ps(_mm_load_ps(v + i), dt4)));
+    }
+#endif
+
+    for (; i < count; i++) {
+        p[i] += v[i] * dt;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    auto entity_count = bench::size_argument(argc, argv, 1, 1'000'000);
+
+    Registry reg;
+    reg.spawn_batch<Position, Velocity>(entity_count, [](size_t i) {
+        return std::tuple { Position { float(i), 0, 0 }, Velocity { 1, 2, 3 } };
+    });
+
+    auto per_row = bench::best_time(repetitions, [&] {
+        reg.query<Position, Velocity const>([](Position& position, Velocity const& velocity) {
+            position.x += velocity.x * dt;
+            position.y += velocity.y * dt;
+            position.z += velocity.z * dt;
+        });
+    });
+
+    auto scalar = bench::best_time(repetitions, [&] {
+        reg.query_chunks<Position, Velocity const>(integrate_scalar);
+    });
+
+    auto simd = bench::best_time(repetitions, [&] {
+        reg.query_chunks<Position, Velocity const>(integrate_simd);
+    });
+
+#if defined(__AVX__)
+    auto simd_name = "AVX";
+#elif defined(BENCH_HAS_SSE)
+    auto simd_name = "SSE";
+#else
+    auto simd_name = "none";
+#endif
+
+    std::printf("entities: %zu, SIMD: %s\n", entity_count, simd_name);
+    std::printf("%-26s %10s %8s\n", "path", "ns/row", "speedup");
+    std::printf("%-26s %10.3f %8.2f\n", "query", per_row / entity_count, 1.0);
+    std::printf("%-26s %10.3f %8.2f\n", "query_chunks, scalar loop", scalar / entity_count, per_row / scalar);
+    std::printf("%-26s %10.3f %8.2f\n", "query_chunks, SIMD kernel", simd / entity_count, per_row / simd);
+}
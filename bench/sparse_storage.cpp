@@ -0,0 +1,100 @@
+// Sparse against table storage for a component that's added and removed
+// constantly: the same timer component stored both ways, churned onto and
+// off a share of the entities, then iterated on its own and joined with a
+// table component.
+//
+// Usage: bench_sparse_storage [entity_count], defaulting to 100k.
+
+#include <bench/bench.hpp>
+#include <cstdio>
+#include <kata/ecs/registry.hpp>
+#include <tuple>
+
+using namespace kata;
+
+struct Position {
+    float x {};
+    float y {};
+    float z {};
+};
+
+struct Velocity {
+    float x {};
+    float y {};
+    float z {};
+};
+
+struct TableTimer {
+    float remaining {};
+};
+
+struct SparseTimer {
+    static constexpr auto storage = StoragePolicy::Sparse;
+
+    float remaining {};
+};
+
+static constexpr int repetitions = 5;
+
+struct Timings {
+    double churn {};
+    double iterate {};
+    double join {};
+};
+
+// One registry per run so both storages start from the same layout.
+template<typename Timer>
+static Timings run(size_t entity_count, size_t stride)
+{
+    Registry reg;
+    auto entities = reg.spawn_batch<Position, Velocity>(entity_count, [](size_t i) {
+        return std::tuple { Position { float(i), 0, 0 }, Velocity { 1, 2, 3 } };
+    });
+
+    auto timed_count = (entity_count + stride - 1) / stride;
+    Timings result;
+
+    result.churn = bench::best_time(repetitions, [&] {
+        for (size_t i = 0; i < entity_count; i += stride) {
+            reg.add_component(entities[i], Timer { 1.0f });
+        }
+
+        for (size_t i = 0; i < entity_count; i += stride) {
+            reg.remove_component<Timer>(entities[i]);
+        }
+    }) / timed_count;
+
+    for (size_t i = 0; i < entity_count; i += stride) {
+        reg.add_component(entities[i], Timer { 1.0f });
+    }
+
+    result.iterate = bench::best_time(repetitions, [&] {
+        reg.query<Timer>([](Timer& timer) {
+            timer.remaining -= 0.016f;
+        });
+    }) / timed_count;
+
+    result.join = bench::best_time(repetitions, [&] {
+        reg.query<Position, Timer const>([](Position& position, Timer const& timer) {
+            position.x += timer.remaining;
+        });
+    }) / timed_count;
+
+    return result;
+}
+
+int main(int argc, char** argv)
+{
+    auto entity_count = bench::size_argument(argc, argv, 1, 100'000);
+
+    std::printf("entities: %zu, times in ns per timed entity\n", entity_count);
+    std::printf("%8s %8s %14s %12s %12s\n", "timed", "storage", "add+remove", "query", "join");
+
+    for (size_t stride : { 100, 10, 1 }) {
+        auto table = run<TableTimer>(entity_count, stride);
+        auto sparse = run<SparseTimer>(entity_count, stride);
+
+        std::printf("%7zu%% %8s %14.1f %12.2f %12.2f\n", 100 / stride, "table", table.churn, table.iterate, table.join);
+        std::printf("%7zu%% %8s %14.1f %12.2f %12.2f\n", 100 / stride, "sparse", sparse.churn, sparse.iterate, sparse.join);
+    }
+}
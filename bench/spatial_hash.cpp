@@ -0,0 +1,174 @@
+// SpatialHashGrid at 10k, 100k and 1M entities spread uniformly at a fixed
+// density: building the grid, moving 1% of the entities directly and
+// through SpatialIndexSystem, and radius, box and k-nearest queries against
+// a brute-force scan over the same positions.
+//
+// Usage: bench_spatial_hash [max_entity_count], defaulting to 1M.
+
+#include <algorithm>
+#include <bench/bench.hpp>
+#include <cmath>
+#include <cstdio>
+#include <kata/ecs/registry.hpp>
+#include <kata/ecs/spatial_hash.hpp>
+#include <random>
+#include <utility>
+#include <vector>
+
+using namespace kata;
+
+static constexpr int repetitions = 5;
+static constexpr size_t query_count = 100;
+static constexpr size_t nearest_count = 8;
+static constexpr float cell_size = 4.0f;
+static constexpr float query_radius = 4.0f;
+
+static float distance_squared(Vec3 a, Vec3 b)
+{
+    auto d = a - b;
+    return d.x * d.x + d.y * d.y + d.z * d.z;
+}
+
+static void run(size_t entity_count)
+{
+    // Roughly one entity per 8 cubic units, whatever the count.
+    auto side = 2.0f * std::cbrt(float(entity_count));
+    std::mt19937 random(1234);
+    std::uniform_real_distribution<float> coordinate(0.0f, side);
+    auto random_point = [&] {
+        return Vec3 { coordinate(random), coordinate(random), coordinate(random) };
+    };
+
+    std::vector<EntityID> ids(entity_count);
+    std::vector<Vec3> positions(entity_count);
+    for (size_t i = 0; i < entity_count; i++) {
+        ids[i] = make_entity_id(uint32_t(i), 1);
+        positions[i] = random_point();
+    }
+
+    std::vector<Vec3> centers(query_count);
+    for (auto& center : centers) {
+        center = random_point();
+    }
+
+    auto moved_count = std::max<size_t>(entity_count / 100, 1);
+    std::printf("%zu entities, %zu queries, radius %.0f, k = %zu\n", entity_count, query_count, query_radius, nearest_count);
+
+    auto build = bench::best_time(repetitions, [&] {
+        SpatialHashGrid grid(cell_size);
+        for (size_t i = 0; i < entity_count; i++) {
+            grid.update(ids[i], positions[i]);
+        }
+    });
+    std::printf("  %-34s %10.1f ns/entity\n", "build", build / entity_count);
+
+    SpatialHashGrid grid(cell_size);
+    for (size_t i = 0; i < entity_count; i++) {
+        grid.update(ids[i], positions[i]);
+    }
+
+    // Small steps, so most moves stay within their cell as in a real frame.
+    Vec3 step { 0.5f, 0.25f, -0.5f };
+    auto update = bench::best_time(repetitions, [&] {
+        for (size_t i = 0; i < entity_count; i += entity_count / moved_count) {
+            positions[i] = positions[i] + step;
+            grid.update(ids[i], positions[i]);
+        }
+    });
+    std::printf("  %-34s %10.1f ns/moved entity\n", "update 1%", update / moved_count);
+
+    {
+        Registry reg;
+        auto entities = reg.spawn_batch<GlobalTransform>(entity_count, [&](size_t i) {
+            return std::tuple { GlobalTransform { Transform { .translation = positions[i] } } };
+        });
+
+        SpatialHashGrid system_grid(cell_size);
+        SpatialIndexSystem index(system_grid);
+        index.run(reg);
+
+        auto system_update = bench::best_time(repetitions, [&] {
+            for (size_t i = 0; i < entity_count; i += entity_count / moved_count) {
+                auto& translation = reg.get<GlobalTransform>(entities[i]).value.translation;
+                translation = translation + step;
+            }
+
+            index.run(reg);
+        });
+        std::printf("  %-34s %10.1f ns/moved entity\n", "move 1% + SpatialIndexSystem", system_update / moved_count);
+    }
+
+    size_t grid_found = 0;
+    size_t brute_found = 0;
+
+    auto grid_radius = bench::best_time(repetitions, [&] {
+        grid_found = 0;
+        for (auto center : centers) {
+            grid.query_radius(center, query_radius, [&](EntityID, Vec3) {
+                grid_found++;
+            });
+        }
+    });
+
+    auto brute_radius = bench::best_time(repetitions, [&] {
+        brute_found = 0;
+        for (auto center : centers) {
+            for (auto position : positions) {
+                brute_found += distance_squared(position, center) <= query_radius * query_radius;
+            }
+        }
+    });
+    std::printf("  %-34s %10.2f us/query (brute force %.2f, %.0fx), %zu found (brute force %zu)\n", "radius", grid_radius / query_count / 1e3, brute_radius / query_count / 1e3, brute_radius / grid_radius, grid_found, brute_found);
+
+    Vec3 extent { query_radius, query_radius, query_radius };
+
+    auto grid_aabb = bench::best_time(repetitions, [&] {
+        grid_found = 0;
+        for (auto center : centers) {
+            grid.query_aabb({ center - extent, center + extent }, [&](EntityID, Vec3) {
+                grid_found++;
+            });
+        }
+    });
+
+    auto brute_aabb = bench::best_time(repetitions, [&] {
+        brute_found = 0;
+        for (auto center : centers) {
+            auto min = center - extent;
+            auto max = center + extent;
+
+            for (auto p : positions) {
+                brute_found += p.x >= min.x && p.y >= min.y && p.z >= min.z && p.x <= max.x && p.y <= max.y && p.z <= max.z;
+            }
+        }
+    });
+    std::printf("  %-34s %10.2f us/query (brute force %.2f, %.0fx), %zu found (brute force %zu)\n", "aabb", grid_aabb / query_count / 1e3, brute_aabb / query_count / 1e3, brute_aabb / grid_aabb, grid_found, brute_found);
+
+    std::vector<EntityID> nearest;
+    auto grid_nearest = bench::best_time(repetitions, [&] {
+        for (auto center : centers) {
+            grid.query_nearest(center, nearest_count, nearest);
+        }
+    });
+
+    std::vector<std::pair<float, EntityID>> candidates(entity_count);
+    auto brute_nearest = bench::best_time(repetitions, [&] {
+        for (auto center : centers) {
+            for (size_t i = 0; i < entity_count; i++) {
+                candidates[i] = { distance_squared(positions[i], center), ids[i] };
+            }
+
+            std::partial_sort(candidates.begin(), candidates.begin() + std::min(nearest_count, entity_count), candidates.end());
+        }
+    });
+    std::printf("  %-34s %10.2f us/query (brute force %.2f, %.0fx), nearest %s\n", "k-nearest", grid_nearest / query_count / 1e3, brute_nearest / query_count / 1e3, brute_nearest / grid_nearest, nearest.size() == nearest_count && nearest.front() == candidates.front().second ? "matches" : "differs");
+}
+
+int main(int argc, char** argv)
+{
+    auto max_entity_count = bench::size_argument(argc, argv, 1, 1'000'000);
+
+    for (size_t entity_count = 10'000; entity_count <= max_entity_count; entity_count *= 10) {
+        run(entity_count);
+    }
+}
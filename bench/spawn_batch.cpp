@@ -0,0 +1,88 @@
+// Bulk spawning: spawn_batch() with a generator and with component columns
+// against a spawn_with() loop, into a fresh registry as on a level load.
+//
+// Usage: bench_spawn_batch [entity_count], defaulting to 500k.
+
+#include <bench/bench.hpp>
+#include <cstdint>
+#include <cstdio>
+#include <kata/ecs/registry.hpp>
+#include <span>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+using namespace kata;
+
+struct Position {
+    float x {};
+    float y {};
+    float z {};
+};
+
+struct Rotation {
+    float x {};
+    float y {};
+    float z {};
+    float w { 1.0f };
+};
+
+struct MeshHandle {
+    uint32_t index {};
+};
+
+static constexpr int repetitions = 5;
+
+// Best time of `spawn(reg)` into a fresh registry, in nanoseconds.
+template<typename F>
+static double time_spawn(F spawn)
+{
+    auto best = double(INFINITY);
+
+    for (int i = 0; i < repetitions; i++) {
+        Registry reg;
+
+        best = std::min(best, bench::best_time(1, [&] {
+            spawn(reg);
+        }));
+    }
+
+    return best;
+}
+
+int main(int argc, char** argv)
+{
+    auto entity_count = bench::size_argument(argc, argv, 1, 500'000);
+
+    std::vector<Position> positions(entity_count);
+    std::vector<Rotation> rotations(entity_count);
+    std::vector<MeshHandle> meshes(entity_count);
+
+    for (size_t i = 0; i < entity_count; i++) {
+        positions[i] = Position { float(i), 0, float(i % 100) };
+        meshes[i] = MeshHandle { uint32_t(i % 16) };
+    }
+
+    auto per_entity = time_spawn([&](Registry& reg) {
+        for (size_t i = 0; i < entity_count; i++) {
+            reg.spawn_with(positions[i], rotations[i], meshes[i]);
+        }
+    });
+
+    auto generator = time_spawn([&](Registry& reg) {
+        reg.spawn_batch<Position, Rotation, MeshHandle>(entity_count, [&](size_t i) {
+            return std::tuple { positions[i], rotations[i], meshes[i] };
+        });
+    });
+
+    auto columns = time_spawn([&](Registry& reg) {
+        reg.spawn_batch(std::span<Position const>(positions), std::span<Rotation const>(rotations), std::span<MeshHandle const>(meshes));
+    });
+
+    std::printf("%zu entities\n", entity_count);
+    std::printf("%-24s %10s %14s %8s\n", "", "ms", "ns/entity", "speedup");
+
+    for (auto [name, ns] : { std::pair { "spawn_with() loop", per_entity }, std::pair { "spawn_batch(generator)", generator }, std::pair { "spawn_batch(columns)", columns } }) {
+        std::printf("%-24s %10.2f %14.1f %8.2f\n", name, ns / 1e6, ns / entity_count, per_entity / ns);
+    }
+}
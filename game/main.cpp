@@ -4,13 +4,74 @@
 #include <kata/ecs/registry.hpp>
 #include <kata/render/render.hpp>
 #include <kata/render/window.hpp>
+#include <span>
 #include <spdlog/spdlog.h>
 
+// MSVC never defines __SSE__, but SSE is always available on x64 and with
+// /arch:SSE or above on x86.
+#if defined(__SSE__) || defined(__AVX__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define GAME_HAS_SSE 1
+#include <immintrin.h>
+#endif
+
 namespace game {
+struct Position {
+    float x {};
+    float y {};
+    float z {};
+};
+
+struct Velocity {
+    float x {};
+    float y {};
+    float z {};
+};
+
+static_assert(sizeof(Position) == 3 * sizeof(float) && sizeof(Velocity) == 3 * sizeof(float));
+
+// position += velocity * dt, one chunk at a time. Both columns are plain
+// float arrays of the same length, so they're processed as flat arrays
+// with SIMD lanes spanning component boundaries.
+void integrate(kata::Registry& reg, float dt)
+{
+    reg.query_chunks<Position, Velocity const>([dt](std::span<Position> positions, std::span<Velocity const> velocities) {
+        auto p = reinterpret_cast<float*>(positions.data());
+        auto v = reinterpret_cast<float const*>(velocities.data());
+        auto count = positions.size() * 3;
+        size_t i = 0;
+
+        // Columns start on 64-byte boundaries, so aligned loads are fine.
+#if defined(__AVX__)
+        auto dt8 = _mm256_set1_ps(dt);
+        for (; i + 8 <= count; i += 8) {
+            _mm256_store_ps(p + i, _mm256_add_ps(_mm256_load_ps(p + i), _mm256_mul_ps(_mm256_load_ps(v + i), dt8)));
+        }
+#endif
+
+#if defined(GAME_HAS_SSE)
+        auto dt4 = _mm_set1_ps(dt);
+        for (; i + 4 <= count; i += 4) {
+            _mm_store_ps(p + i, _mm_add_ps(_mm_load_ps(p + i), _mm_mul_ps(_mm_load_ps(v + i), dt4)));
+        }
+#endif
+
+        for (; i < count; i++) {
+            p[i] += v[i] * dt;
+        }
+    });
+}
+
 class App : public kata::App {
     virtual void init() override
     {
         spdlog::info("hello, world!");
+
+        auto& reg = registry();
+        reg.spawn_batch<Position, Velocity>(1000, [](size_t i) {
+            return std::tuple { Position {}, Velocity { .x = float(i), .y = 1.0f, .z = 0.0f } };
+        });
+
+        integrate(reg, 1.0f / 60.0f);
     }
 };
 }
@@ -85,9 +85,12 @@ void run(App& app)
     setup_glfw_callback_trampolines(app, app.renderer().window());
 
     while (!app.renderer().window().should_close() && !app.input().is_key_pressed(Key::Escape)) {
+        app.input().flush_events();
         glfwPollEvents();
 
         app.renderer().render();
+
+        app.registry().advance_tick();
     }
 }
 }
@@ -0,0 +1,195 @@
+#include <kata/core/job_system.hpp>
+
+namespace kata {
+static thread_local JobSystem* s_current_system = nullptr;
+static thread_local size_t s_worker_index = 0;
+
+JobSystem::JobSystem(size_t worker_count)
+{
+    m_queues.reserve(worker_count);
+    for (size_t i = 0; i < worker_count; i++) {
+        m_queues.push_back(std::make_unique<WorkerQueue>());
+    }
+
+    m_workers.reserve(worker_count);
+    for (size_t i = 0; i < worker_count; i++) {
+        m_workers.emplace_back([this, i] {
+            worker_loop(i);
+        });
+    }
+}
+
+JobSystem::~JobSystem()
+{
+    m_stopping = true;
+
+    {
+        std::scoped_lock lock(m_sleep_mutex);
+    }
+
+    m_wake.notify_all();
+
+    for (auto& worker : m_workers) {
+        worker.join();
+    }
+}
+
+JobSystem& JobSystem::shared()
+{
+    static JobSystem system(std::max(std::thread::hardware_concurrency(), 1u) - 1);
+
+    return system;
+}
+
+size_t JobSystem::current_thread_slot() const
+{
+    if (s_current_system != this) {
+        return 0;
+    }
+
+    return s_worker_index + 1;
+}
+
+void JobSystem::submit(JobCounter& counter, std::function<void()> fn)
+{
+    counter.increment();
+
+    auto& queue = s_current_system == this ? *m_queues[s_worker_index] : m_injection_queue;
+
+    {
+        std::scoped_lock lock(queue.mutex);
+        queue.jobs.push_back(Job {
+            .fn = std::move(fn),
+            .counter = &counter,
+        });
+    }
+
+    m_queued_jobs++;
+
+    if (m_sleeping_workers > 0) {
+        // Taking the lock orders this notification after a worker that has
+        // just decided to sleep actually started waiting.
+        {
+            std::scoped_lock lock(m_sleep_mutex);
+        }
+
+        m_wake.notify_one();
+    }
+}
+
+void JobSystem::wait(JobCounter const& counter)
+{
+    while (!counter.is_done()) {
+        if (!try_run_one()) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+void JobSystem::worker_loop(size_t index)
+{
+    s_current_system = this;
+    s_worker_index = index;
+
+    constexpr int spins_before_sleep = 64;
+
+    while (!m_stopping) {
+        bool found_work = false;
+
+        for (int spin = 0; spin < spins_before_sleep && !found_work; spin++) {
+            found_work = try_run_one();
+
+            if (!found_work) {
+                std::this_thread::yield();
+            }
+        }
+
+        if (found_work) {
+            continue;
+        }
+
+        m_sleeping_workers++;
+
+        {
+            std::unique_lock lock(m_sleep_mutex);
+            m_wake.wait(lock, [this] {
+                return m_stopping || m_queued_jobs > 0;
+            });
+        }
+
+        m_sleeping_workers--;
+    }
+}
+
+bool JobSystem::try_run_one()
+{
+    Job job {};
+    if (!pop_job(job)) {
+        return false;
+    }
+
+    run(job);
+
+    return true;
+}
+
+bool JobSystem::pop_job(Job& job)
+{
+    if (m_queued_jobs == 0) {
+        return false;
+    }
+
+    auto take = [&](WorkerQueue& queue, bool from_back) {
+        std::scoped_lock lock(queue.mutex);
+
+        if (queue.jobs.empty()) {
+            return false;
+        }
+
+        if (from_back) {
+            job = std::move(queue.jobs.back());
+            queue.jobs.pop_back();
+        } else {
+            job = std::move(queue.jobs.front());
+            queue.jobs.pop_front();
+        }
+
+        m_queued_jobs--;
+
+        return true;
+    };
+
+    bool is_worker = s_current_system == this;
+
+    // Own jobs are taken LIFO for cache locality, everything else FIFO.
+    if (is_worker && take(*m_queues[s_worker_index], true)) {
+        return true;
+    }
+
+    if (take(m_injection_queue, false)) {
+        return true;
+    }
+
+    auto start = is_worker ? s_worker_index + 1 : 0;
+
+    for (size_t i = 0; i < m_queues.size(); i++) {
+        auto victim = (start + i) % m_queues.size();
+
+        if (is_worker && victim == s_worker_index) {
+            continue;
+        }
+
+        if (take(*m_queues[victim], false)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void JobSystem::run(Job& job)
+{
+    job.fn();
+    job.counter->decrement();
+}
+}
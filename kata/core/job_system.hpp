@@ -0,0 +1,152 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace kata {
+// Number of unfinished jobs submitted against it. A counter may have a
+// parent, which then stays pending for as long as the counter is non-zero;
+// this is how child jobs keep their parent's wait() blocked.
+//
+// A counter must outlive every job submitted against it, and a parent every
+// child counter: a job touches its counter after returning, so e.g. a job
+// that submits children against a local counter has to wait() on it before
+// returning.
+class JobCounter {
+public:
+    explicit JobCounter(JobCounter* parent = nullptr)
+        : m_parent(parent)
+    {
+    }
+
+    JobCounter(JobCounter const&) = delete;
+    JobCounter& operator=(JobCounter const&) = delete;
+
+    bool is_done() const
+    {
+        return m_pending.load(std::memory_order_acquire) == 0;
+    }
+
+    void increment()
+    {
+        if (m_pending.fetch_add(1, std::memory_order_relaxed) == 0 && m_parent) {
+            m_parent->increment();
+        }
+    }
+
+    void decrement()
+    {
+        // A waiter may destroy the counter as soon as it reaches zero, so
+        // don't touch any members after the fetch_sub.
+        auto parent = m_parent;
+
+        if (m_pending.fetch_sub(1, std::memory_order_acq_rel) == 1 && parent) {
+            parent->decrement();
+        }
+    }
+
+private:
+    JobCounter* m_parent { nullptr };
+    std::atomic<uint32_t> m_pending {};
+};
+
+// Work-stealing job system. Every worker owns a deque: it pushes and pops
+// its own jobs at the back and idle workers steal from the front. Jobs
+// submitted from outside the pool go through a shared injection queue.
+class JobSystem {
+public:
+    // Spawns `worker_count` threads. Threads calling wait() help execute jobs,
+    // so a system with zero workers still makes progress.
+    explicit JobSystem(size_t worker_count);
+    ~JobSystem();
+
+    JobSystem(JobSystem const&) = delete;
+    JobSystem& operator=(JobSystem const&) = delete;
+
+    // Process-wide job system with one worker per hardware thread besides
+    // the main thread.
+    static JobSystem& shared();
+
+    size_t worker_count() const
+    {
+        return m_workers.size();
+    }
+
+    // 0 for threads outside the pool and 1 + worker index for workers, so
+    // callers can keep per-thread state (e.g. command buffers) in an array of
+    // worker_count() + 1 slots without locking. Slot 0 is shared by every
+    // non-worker thread; only the thread driving the job system should use it.
+    size_t current_thread_slot() const;
+
+    // Queues `fn` and increments `counter` until it has run.
+    void submit(JobCounter& counter, std::function<void()> fn);
+
+    // Executes pending jobs on the calling thread until `counter` reaches zero.
+    void wait(JobCounter const& counter);
+
+    // Calls f(begin, end) over [0, count) in ranges of at most `grain_size`
+    // and waits for all of them.
+    template<typename F>
+    void parallel_for(size_t count, size_t grain_size, F const& f)
+    {
+        if (count == 0) {
+            return;
+        }
+
+        if (count <= grain_size) {
+            f(size_t(0), count);
+            return;
+        }
+
+        JobCounter counter {};
+
+        for (size_t begin = 0; begin < count; begin += grain_size) {
+            auto end = std::min(begin + grain_size, count);
+
+            submit(counter, [&f, begin, end] {
+                f(begin, end);
+            });
+        }
+
+        wait(counter);
+    }
+
+private:
+    struct Job {
+        std::function<void()> fn {};
+        JobCounter* counter { nullptr };
+    };
+
+    struct WorkerQueue {
+        std::mutex mutex {};
+        std::deque<Job> jobs {};
+    };
+
+    void worker_loop(size_t index);
+
+    // Pops from the caller's own queue, then the injection queue, then
+    // steals from other workers.
+    bool try_run_one();
+    bool pop_job(Job& job);
+    void run(Job& job);
+
+    std::vector<std::unique_ptr<WorkerQueue>> m_queues {};
+    WorkerQueue m_injection_queue {};
+    std::vector<std::thread> m_workers {};
+
+    std::mutex m_sleep_mutex {};
+    std::condition_variable m_wake {};
+    std::atomic<size_t> m_queued_jobs {};
+    std::atomic<size_t> m_sleeping_workers {};
+    std::atomic<bool> m_stopping {};
+};
+}
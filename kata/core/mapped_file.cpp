@@ -0,0 +1,122 @@
+#include <kata/core/mapped_file.hpp>
+#include <utility>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace kata {
+Result<MappedFile> MappedFile::open(std::filesystem::path const& path)
+{
+    MappedFile file;
+
+#if defined(_WIN32)
+    auto handle = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (handle == INVALID_HANDLE_VALUE) {
+        return Error::with_message("Failed to open " + path.string());
+    }
+
+    LARGE_INTEGER size {};
+    if (!GetFileSizeEx(handle, &size)) {
+        CloseHandle(handle);
+        return Error::with_message("Failed to get the size of " + path.string());
+    }
+
+    file.m_size = size_t(size.QuadPart);
+
+    if (file.m_size > 0) {
+        // The view keeps the mapping alive, so both handles can be closed right away.
+        auto mapping = CreateFileMappingW(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        auto view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+
+        if (mapping) {
+            CloseHandle(mapping);
+        }
+
+        if (!view) {
+            CloseHandle(handle);
+            return Error::with_message("Failed to map " + path.string());
+        }
+
+        file.m_data = static_cast<std::byte const*>(view);
+    }
+
+    CloseHandle(handle);
+#else
+    auto fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return Error::with_message("Failed to open " + path.string());
+    }
+
+    struct stat status {};
+    if (fstat(fd, &status) != 0) {
+        close(fd);
+        return Error::with_message("Failed to get the size of " + path.string());
+    }
+
+    file.m_size = size_t(status.st_size);
+
+    if (file.m_size > 0) {
+        auto data = mmap(nullptr, file.m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+        if (data == MAP_FAILED) {
+            close(fd);
+            return Error::with_message("Failed to map " + path.string());
+        }
+
+        madvise(data, file.m_size, MADV_SEQUENTIAL);
+        file.m_data = static_cast<std::byte const*>(data);
+    }
+
+    // The mapping keeps its own reference to the file.
+    close(fd);
+#endif
+
+    return file;
+}
+
+MappedFile::~MappedFile()
+{
+    unmap();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+    : m_data(std::exchange(other.m_data, nullptr))
+    , m_size(std::exchange(other.m_size, 0))
+{
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+    if (this != &other) {
+        unmap();
+        m_data = std::exchange(other.m_data, nullptr);
+        m_size = std::exchange(other.m_size, 0);
+    }
+
+    return *this;
+}
+
+void MappedFile::unmap()
+{
+    if (!m_data) {
+        return;
+    }
+
+#if defined(_WIN32)
+    UnmapViewOfFile(m_data);
+#else
+    munmap(const_cast<std::byte*>(m_data), m_size);
+#endif
+
+    m_data = nullptr;
+    m_size = 0;
+}
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <kata/core/error.hpp>
+#include <span>
+
+namespace kata {
+// Read-only memory mapping of a whole file. Pages are loaded by the OS on
+// first access, so opening even very large files is cheap.
+class MappedFile {
+public:
+    static Result<MappedFile> open(std::filesystem::path const& path);
+
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+
+    MappedFile(MappedFile const&) = delete;
+    MappedFile& operator=(MappedFile const&) = delete;
+
+    std::span<std::byte const> bytes() const
+    {
+        return { m_data, m_size };
+    }
+
+private:
+    void unmap();
+
+    std::byte const* m_data { nullptr };
+    size_t m_size {};
+};
+}
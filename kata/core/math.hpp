@@ -0,0 +1,90 @@
+#pragma once
+
+namespace kata {
+struct Vec3 {
+    float x {};
+    float y {};
+    float z {};
+
+    friend Vec3 operator+(Vec3 a, Vec3 b)
+    {
+        return { a.x + b.x, a.y + b.y, a.z + b.z };
+    }
+
+    friend Vec3 operator-(Vec3 a, Vec3 b)
+    {
+        return { a.x - b.x, a.y - b.y, a.z - b.z };
+    }
+
+    friend Vec3 operator*(Vec3 v, float s)
+    {
+        return { v.x * s, v.y * s, v.z * s };
+    }
+
+    friend Vec3 operator*(float s, Vec3 v)
+    {
+        return v * s;
+    }
+
+    friend bool operator==(Vec3, Vec3) = default;
+};
+
+inline Vec3 cross(Vec3 a, Vec3 b)
+{
+    return {
+        a.y * b.z - a.z * b.y,
+        a.z * b.x - a.x * b.z,
+        a.x * b.y - a.y * b.x,
+    };
+}
+
+// Unit quaternion representing a rotation.
+struct Quat {
+    float x {};
+    float y {};
+    float z {};
+    float w { 1.0f };
+
+    // Applies `b` first, then `a`.
+    friend Quat operator*(Quat a, Quat b)
+    {
+        return {
+            a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y,
+            a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x,
+            a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w,
+            a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z,
+        };
+    }
+
+    friend Vec3 operator*(Quat q, Vec3 v)
+    {
+        Vec3 u { q.x, q.y, q.z };
+        auto t = 2.0f * cross(u, v);
+
+        return v + q.w * t + cross(u, t);
+    }
+
+    friend bool operator==(Quat, Quat) = default;
+};
+
+// Translation, rotation and uniform scale. Uniform scale keeps composition
+// closed, so a parent's transform applied to a child's is again a Transform.
+struct Transform {
+    Vec3 translation {};
+    Quat rotation {};
+    float scale { 1.0f };
+
+    // `parent * child` maps points from the child's space to the space `parent`
+    // is expressed in.
+    friend Transform operator*(Transform const& parent, Transform const& child)
+    {
+        return {
+            .translation = parent.translation + parent.rotation * (child.translation * parent.scale),
+            .rotation = parent.rotation * child.rotation,
+            .scale = parent.scale * child.scale,
+        };
+    }
+
+    friend bool operator==(Transform const&, Transform const&) = default;
+};
+}
@@ -0,0 +1,298 @@
+#include <algorithm>
+#include <kata/ecs/archetype.hpp>
+
+namespace kata {
+static size_t align_up(size_t value, size_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+size_t ArchetypeSignatureHash::operator()(std::span<ComponentID const> signature) const
+{
+    // FNV-1a over the component IDs
+    uint64_t hash = 0xcbf29ce484222325;
+
+    for (auto id : signature) {
+        hash ^= id;
+        hash *= 0x100000001b3;
+    }
+
+    return size_t(hash);
+}
+
+Archetype::Archetype(std::vector<ComponentInfo const*> components)
+{
+    std::sort(components.begin(), components.end(), [](auto a, auto b) {
+        return a->id < b->id;
+    });
+
+    m_signature.reserve(components.size());
+    m_columns.reserve(components.size());
+
+    for (auto info : components) {
+        if (info->id >= m_column_by_component.size()) {
+            m_column_by_component.resize(info->id + 1, no_column);
+        }
+
+        assert(m_column_by_component[info->id] == no_column && "duplicate component in archetype");
+        assert(info->alignment <= chunk_alignment);
+
+        m_signature.push_back(info->id);
+        m_mask.set(info->id);
+
+        if (info->is_tag) {
+            m_column_by_component[info->id] = tag_column;
+            continue;
+        }
+
+        m_column_by_component[info->id] = uint32_t(m_columns.size());
+        m_columns.push_back(ColumnLayout { .info = info });
+    }
+
+    m_components = std::move(components);
+
+    // Lays out `capacity` rows and returns the number of bytes used.
+    auto layout = [&](size_t capacity) {
+        size_t offset = capacity * sizeof(EntityID);
+
+        for (auto& column : m_columns) {
+            column.offset = align_up(offset, column_alignment);
+            offset = column.offset + capacity * column.info->size;
+        }
+
+        for (auto& column : m_columns) {
+            column.added_ticks_offset = align_up(offset, alignof(ChangeTick));
+            column.changed_ticks_offset = column.added_ticks_offset + capacity * sizeof(ChangeTick);
+            offset = column.changed_ticks_offset + capacity * sizeof(ChangeTick);
+        }
+
+        return offset;
+    };
+
+    size_t row_bytes = sizeof(EntityID);
+    for (auto& column : m_columns) {
+        row_bytes += column.info->size + 2 * sizeof(ChangeTick);
+    }
+
+    m_chunk_capacity = std::max<size_t>(chunk_bytes / row_bytes, 1);
+
+    while (m_chunk_capacity > 1 && layout(m_chunk_capacity) > chunk_bytes) {
+        m_chunk_capacity--;
+    }
+
+    // Rows bigger than a chunk get oversized single-row chunks.
+    m_chunk_bytes = std::max(chunk_bytes, align_up(layout(m_chunk_capacity), chunk_alignment));
+}
+
+Archetype::~Archetype()
+{
+    for (uint32_t column = 0; column < m_columns.size(); column++) {
+        auto& info = *m_columns[column].info;
+
+        if (info.is_trivially_copyable) {
+            continue;
+        }
+
+        for (size_t row = 0; row < m_size; row++) {
+            info.destroy(at(column, row));
+        }
+    }
+
+    for (auto chunk : m_chunks) {
+        ::operator delete(chunk, std::align_val_t(chunk_alignment));
+    }
+}
+
+size_t Archetype::push_row_uninitialized(EntityID id, ChangeTick tick)
+{
+    auto row = m_size;
+
+    reserve(m_size + 1);
+
+    m_size++;
+    chunk_ids(row / m_chunk_capacity)[row % m_chunk_capacity] = id;
+
+    for (uint32_t column = 0; column < m_columns.size(); column++) {
+        added_tick_at(column, row) = tick;
+        changed_tick_at(column, row) = tick;
+    }
+
+    return row;
+}
+
+template<typename Ids>
+size_t Archetype::push_rows(Ids const& ids, ChangeTick tick)
+{
+    auto first_row = m_size;
+
+    reserve(m_size + ids.size());
+    m_size += ids.size();
+
+    for_each_chunk_segment(first_row, ids.size(), [&](size_t chunk, size_t index, size_t count, size_t done) {
+        auto chunk_id_column = chunk_ids(chunk) + index;
+
+        for (size_t i = 0; i < count; i++) {
+            chunk_id_column[i] = ids[done + i];
+        }
+
+        for (uint32_t column = 0; column < m_columns.size(); column++) {
+            std::fill_n(chunk_added_ticks(chunk, column) + index, count, tick);
+            std::fill_n(chunk_changed_ticks(chunk, column) + index, count, tick);
+        }
+    });
+
+    return first_row;
+}
+
+size_t Archetype::push_rows_uninitialized(EntityRange const& ids, ChangeTick tick)
+{
+    return push_rows(ids, tick);
+}
+
+size_t Archetype::push_rows_uninitialized(std::span<EntityID const> ids, ChangeTick tick)
+{
+    return push_rows(ids, tick);
+}
+
+void Archetype::reserve(size_t rows)
+{
+    auto chunks = (rows + m_chunk_capacity - 1) / m_chunk_capacity;
+
+    while (m_chunks.size() < chunks) {
+        auto chunk = ::operator new(m_chunk_bytes, std::align_val_t(chunk_alignment));
+        m_chunks.push_back(static_cast<std::byte*>(chunk));
+    }
+}
+
+size_t Archetype::shrink_to_fit()
+{
+    auto used = chunk_count();
+    auto freed = m_chunks.size() - used;
+
+    for (auto i = used; i < m_chunks.size(); i++) {
+        ::operator delete(m_chunks[i], std::align_val_t(chunk_alignment));
+    }
+
+    auto pointer_bytes = m_chunks.capacity() * sizeof(std::byte*);
+    m_chunks.resize(used);
+    m_chunks.shrink_to_fit();
+
+    return freed * m_chunk_bytes + pointer_bytes - m_chunks.capacity() * sizeof(std::byte*);
+}
+
+size_t Archetype::move_row_to(size_t row, Archetype& dst, ChangeTick tick)
+{
+    assert(row < m_size);
+
+    auto dst_row = dst.push_row_uninitialized(id_at(row), tick);
+
+    for (uint32_t column = 0; column < m_columns.size(); column++) {
+        auto& info = *m_columns[column].info;
+        auto dst_column = dst.column_index(info.id);
+
+        if (dst_column != no_column) {
+            relocate_component(info, dst.at(dst_column, dst_row), at(column, row));
+            dst.added_tick_at(dst_column, dst_row) = added_tick_at(column, row);
+            dst.changed_tick_at(dst_column, dst_row) = changed_tick_at(column, row);
+        } else {
+            destroy_component(info, at(column, row));
+        }
+    }
+
+    fill_hole(row);
+
+    return dst_row;
+}
+
+void Archetype::remove_row(size_t row)
+{
+    assert(row < m_size);
+
+    for (uint32_t column = 0; column < m_columns.size(); column++) {
+        destroy_component(*m_columns[column].info, at(column, row));
+    }
+
+    fill_hole(row);
+}
+
+size_t Archetype::splice(Archetype& other, ChangeTick tick)
+{
+    assert(m_signature == other.m_signature);
+
+    if (other.m_size == 0) {
+        return m_size;
+    }
+
+    for (size_t chunk = 0; chunk < other.chunk_count(); chunk++) {
+        auto rows = other.chunk_row_count(chunk);
+
+        for (uint32_t column = 0; column < m_columns.size(); column++) {
+            std::fill_n(other.chunk_added_ticks(chunk, column), rows, tick);
+            std::fill_n(other.chunk_changed_ticks(chunk, column), rows, tick);
+        }
+    }
+
+    // All chunks but the last must be full, so a partially filled last chunk
+    // is taken out and its rows are appended after the spliced ones.
+    auto used = chunk_count();
+    auto partial_rows = m_size % m_chunk_capacity;
+    std::byte* partial = nullptr;
+
+    if (partial_rows > 0) {
+        partial = m_chunks[used - 1];
+        m_chunks.erase(m_chunks.begin() + ptrdiff_t(used - 1));
+        used--;
+        m_size -= partial_rows;
+    }
+
+    auto first_changed = m_size;
+    auto other_used = ptrdiff_t(other.chunk_count());
+
+    m_chunks.insert(m_chunks.begin() + ptrdiff_t(used), other.m_chunks.begin(), other.m_chunks.begin() + other_used);
+    other.m_chunks.erase(other.m_chunks.begin(), other.m_chunks.begin() + other_used);
+    m_size += other.m_size;
+    other.m_size = 0;
+
+    if (!partial) {
+        return first_changed;
+    }
+
+    reserve(m_size + partial_rows);
+
+    for (size_t i = 0; i < partial_rows; i++) {
+        auto row = m_size++;
+
+        chunk_ids(row / m_chunk_capacity)[row % m_chunk_capacity] = reinterpret_cast<EntityID*>(partial)[i];
+
+        for (uint32_t column = 0; column < m_columns.size(); column++) {
+            auto& layout = m_columns[column];
+
+            relocate_component(*layout.info, at(column, row), partial + layout.offset + i * layout.info->size);
+            added_tick_at(column, row) = reinterpret_cast<ChangeTick*>(partial + layout.added_ticks_offset)[i];
+            changed_tick_at(column, row) = reinterpret_cast<ChangeTick*>(partial + layout.changed_ticks_offset)[i];
+        }
+    }
+
+    // The emptied chunk is kept for reuse like any other spare chunk.
+    m_chunks.push_back(partial);
+
+    return first_changed;
+}
+
+void Archetype::fill_hole(size_t row)
+{
+    auto last = m_size - 1;
+
+    if (row != last) {
+        for (uint32_t column = 0; column < m_columns.size(); column++) {
+            relocate_component(*m_columns[column].info, at(column, row), at(column, last));
+            added_tick_at(column, row) = added_tick_at(column, last);
+            changed_tick_at(column, row) = changed_tick_at(column, last);
+        }
+
+        chunk_ids(row / m_chunk_capacity)[row % m_chunk_capacity] = id_at(last);
+    }
+
+    m_size--;
+}
+}
@@ -0,0 +1,332 @@
+#pragma once
+
+#include <algorithm>
+#include <assert.h>
+#include <cstddef>
+#include <kata/ecs/component.hpp>
+#include <kata/ecs/id_allocator.hpp>
+#include <span>
+#include <vector>
+
+namespace kata {
+// Canonical, order-independent identity of an archetype: its component IDs, sorted.
+using ArchetypeSignature = std::vector<ComponentID>;
+
+struct ArchetypeSignatureHash {
+    using is_transparent = void;
+
+    size_t operator()(std::span<ComponentID const> signature) const;
+};
+
+struct ArchetypeSignatureEqual {
+    using is_transparent = void;
+
+    bool operator()(std::span<ComponentID const> a, std::span<ComponentID const> b) const
+    {
+        return std::equal(a.begin(), a.end(), b.begin(), b.end());
+    }
+};
+
+// One bit per ComponentID. Archetypes and queries each carry one, so matching
+// a query against an archetype is a few word-wide ANDs.
+class ComponentMask {
+public:
+    void set(ComponentID id)
+    {
+        auto word = id / 64;
+        if (word >= m_words.size()) {
+            m_words.resize(word + 1);
+        }
+
+        m_words[word] |= uint64_t(1) << (id % 64);
+    }
+
+    bool test(ComponentID id) const
+    {
+        auto word = id / 64;
+
+        return word < m_words.size() && (m_words[word] >> (id % 64)) & 1;
+    }
+
+    // Whether every component in `other` is also in this mask.
+    bool contains(ComponentMask const& other) const
+    {
+        for (size_t i = 0; i < other.m_words.size(); i++) {
+            auto word = i < m_words.size() ? m_words[i] : 0;
+
+            if ((word & other.m_words[i]) != other.m_words[i]) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    bool intersects(ComponentMask const& other) const
+    {
+        auto count = std::min(m_words.size(), other.m_words.size());
+
+        for (size_t i = 0; i < count; i++) {
+            if (m_words[i] & other.m_words[i]) {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+private:
+    std::vector<uint64_t> m_words {};
+};
+
+class Archetype;
+
+// Cached neighbours in the archetype graph: the archetypes reached by adding
+// or removing a single component.
+struct ArchetypeEdge {
+    Archetype* add { nullptr };
+    Archetype* remove { nullptr };
+};
+
+// Monotonic counter bumped by Registry::advance_tick() and
+// Registry::track_changes(). Every row of a column records the tick at which
+// its component was added and the tick at which it was last handed out
+// mutably. 64 bits so it never wraps: a 32-bit counter bumped by several
+// trackers every frame would wrap within days of uptime, after which old
+// rows would compare as newer than the query window.
+using ChangeTick = uint64_t;
+
+// Where a column and its change ticks live inside each chunk.
+struct ColumnLayout {
+    ComponentInfo const* info { nullptr };
+    size_t offset {};
+    size_t added_ticks_offset {};
+    size_t changed_ticks_offset {};
+};
+
+// Rows are stored in fixed-size chunks. A chunk holds the entity IDs and
+// every column for a contiguous range of rows, so growing an archetype only
+// ever allocates a new chunk and never copies existing rows. All chunks
+// except the last one are full; row `r` lives in chunk `r / chunk_capacity()`.
+//
+// Every column starts on a `column_alignment` boundary, so SIMD code can use
+// aligned loads from the start of chunk_column().
+//
+// Tag components (see is_tag_component) are part of the signature but have
+// no column.
+class Archetype {
+public:
+    static constexpr uint32_t no_column = UINT32_MAX;
+    static constexpr uint32_t tag_column = UINT32_MAX - 1;
+    static constexpr size_t chunk_bytes = 16 * 1024;
+    static constexpr size_t chunk_alignment = 64;
+    static constexpr size_t column_alignment = chunk_alignment;
+
+    explicit Archetype(std::vector<ComponentInfo const*> components);
+    ~Archetype();
+
+    Archetype(Archetype const&) = delete;
+    Archetype& operator=(Archetype const&) = delete;
+
+    ArchetypeSignature const& signature() const
+    {
+        return m_signature;
+    }
+
+    // no_column if the component is absent, tag_column if it's a tag.
+    uint32_t column_index(ComponentID id) const
+    {
+        if (id >= m_column_by_component.size()) {
+            return no_column;
+        }
+
+        return m_column_by_component[id];
+    }
+
+    bool has_component(ComponentID id) const
+    {
+        return column_index(id) != no_column;
+    }
+
+    size_t column_count() const
+    {
+        return m_columns.size();
+    }
+
+    ComponentInfo const& column_info(uint32_t column) const
+    {
+        return *m_columns[column].info;
+    }
+
+    ArchetypeEdge& edge(ComponentID id)
+    {
+        if (id >= m_edges.size()) {
+            m_edges.resize(id + 1);
+        }
+
+        return m_edges[id];
+    }
+
+    // Drops the cached edges leading to `other`, e.g. before it's destroyed.
+    void remove_edges_to(Archetype const* other)
+    {
+        for (auto& edge : m_edges) {
+            if (edge.add == other) {
+                edge.add = nullptr;
+            }
+
+            if (edge.remove == other) {
+                edge.remove = nullptr;
+            }
+        }
+    }
+
+    ComponentMask const& mask() const
+    {
+        return m_mask;
+    }
+
+    // Every component of the archetype, tags included, sorted by ID.
+    std::span<ComponentInfo const* const> components() const
+    {
+        return m_components;
+    }
+
+    size_t chunk_capacity() const
+    {
+        return m_chunk_capacity;
+    }
+
+    // Number of chunks holding at least one row.
+    size_t chunk_count() const
+    {
+        return (m_size + m_chunk_capacity - 1) / m_chunk_capacity;
+    }
+
+    size_t chunk_row_count(size_t chunk) const
+    {
+        return std::min(m_chunk_capacity, m_size - chunk * m_chunk_capacity);
+    }
+
+    void* chunk_column(size_t chunk, uint32_t column)
+    {
+        return m_chunks[chunk] + m_columns[column].offset;
+    }
+
+    EntityID* chunk_ids(size_t chunk)
+    {
+        return reinterpret_cast<EntityID*>(m_chunks[chunk]);
+    }
+
+    ChangeTick* chunk_added_ticks(size_t chunk, uint32_t column)
+    {
+        return reinterpret_cast<ChangeTick*>(m_chunks[chunk] + m_columns[column].added_ticks_offset);
+    }
+
+    ChangeTick* chunk_changed_ticks(size_t chunk, uint32_t column)
+    {
+        return reinterpret_cast<ChangeTick*>(m_chunks[chunk] + m_columns[column].changed_ticks_offset);
+    }
+
+    void* at(uint32_t column, size_t row)
+    {
+        auto chunk = row / m_chunk_capacity;
+        auto index = row % m_chunk_capacity;
+
+        return static_cast<std::byte*>(chunk_column(chunk, column)) + index * m_columns[column].info->size;
+    }
+
+    EntityID id_at(size_t row)
+    {
+        return chunk_ids(row / m_chunk_capacity)[row % m_chunk_capacity];
+    }
+
+    ChangeTick& added_tick_at(uint32_t column, size_t row)
+    {
+        return chunk_added_ticks(row / m_chunk_capacity, column)[row % m_chunk_capacity];
+    }
+
+    ChangeTick& changed_tick_at(uint32_t column, size_t row)
+    {
+        return chunk_changed_ticks(row / m_chunk_capacity, column)[row % m_chunk_capacity];
+    }
+
+    // Appends a row for `id` and returns its index. All of its components are
+    // marked as added at `tick`. The caller is responsible for constructing
+    // every column of the row in place.
+    size_t push_row_uninitialized(EntityID id, ChangeTick tick);
+
+    // Appends rows for all of `ids` and returns the index of the first one.
+    size_t push_rows_uninitialized(EntityRange const& ids, ChangeTick tick);
+    size_t push_rows_uninitialized(std::span<EntityID const> ids, ChangeTick tick);
+
+    // Makes sure `rows` rows fit without allocating more chunks.
+    void reserve(size_t rows);
+
+    // Frees the spare chunks kept around for reuse and returns the number of
+    // bytes released.
+    size_t shrink_to_fit();
+
+    // Splits rows [first_row, first_row + count) at chunk boundaries and calls
+    // f(chunk, first_index_in_chunk, row_count, rows_before) for each piece.
+    template<typename F>
+    void for_each_chunk_segment(size_t first_row, size_t count, F f)
+    {
+        size_t done = 0;
+
+        while (done < count) {
+            auto row = first_row + done;
+            auto chunk = row / m_chunk_capacity;
+            auto index = row % m_chunk_capacity;
+            auto n = std::min(m_chunk_capacity - index, count - done);
+
+            f(chunk, index, n, done);
+
+            done += n;
+        }
+    }
+
+    // Moves the row to `dst`, relocating shared components (with their change
+    // ticks) and destroying the rest. Components only present in `dst` are
+    // marked as added at `tick` and left for the caller to construct. The
+    // last row of this archetype is swapped into `row`; returns the row index
+    // in `dst`.
+    size_t move_row_to(size_t row, Archetype& dst, ChangeTick tick);
+
+    // Destroys the row; the last row is swapped into its place.
+    void remove_row(size_t row);
+
+    // Moves all rows of `other`, which must have the same signature, to the
+    // end of this archetype by taking over its chunks; only the rows of this
+    // archetype's partially filled last chunk are copied. The taken rows are
+    // marked as added at `tick`. Returns the first row whose index changed:
+    // every row from there to size() needs its location updated.
+    size_t splice(Archetype& other, ChangeTick tick);
+
+    size_t size() const
+    {
+        return m_size;
+    }
+
+private:
+    // Fills the hole at `row`, whose components were already destroyed or
+    // relocated, with the last row.
+    void fill_hole(size_t row);
+
+    template<typename Ids>
+    size_t push_rows(Ids const& ids, ChangeTick tick);
+
+    ArchetypeSignature m_signature {};
+    ComponentMask m_mask {};
+    std::vector<ComponentInfo const*> m_components {};
+    std::vector<ColumnLayout> m_columns {};
+    std::vector<uint32_t> m_column_by_component {};
+    std::vector<ArchetypeEdge> m_edges {};
+
+    // Chunks past chunk_count() are empty and kept around for reuse.
+    std::vector<std::byte*> m_chunks {};
+    size_t m_chunk_capacity {};
+    size_t m_chunk_bytes {};
+    size_t m_size {};
+};
+}
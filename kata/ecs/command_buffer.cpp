@@ -0,0 +1,344 @@
+#include <algorithm>
+#include <kata/ecs/command_buffer.hpp>
+#include <utility>
+
+namespace kata {
+CommandBuffer::~CommandBuffer()
+{
+    destroy_payloads();
+}
+
+CommandBuffer::CommandBuffer(CommandBuffer&& other)
+    : m_commands(std::move(other.m_commands))
+    , m_spawn_payloads(std::move(other.m_spawn_payloads))
+    , m_blocks(std::move(other.m_blocks))
+    , m_current_block(other.m_current_block)
+    , m_block_offset(other.m_block_offset)
+    , m_order(std::move(other.m_order))
+{
+    other.clear();
+}
+
+CommandBuffer& CommandBuffer::operator=(CommandBuffer&& other)
+{
+    if (this == &other) {
+        return *this;
+    }
+
+    // The payloads live in m_blocks, so they have to go before the blocks do.
+    destroy_payloads();
+
+    m_commands = std::move(other.m_commands);
+    m_spawn_payloads = std::move(other.m_spawn_payloads);
+    m_blocks = std::move(other.m_blocks);
+    m_current_block = other.m_current_block;
+    m_block_offset = other.m_block_offset;
+    m_order = std::move(other.m_order);
+
+    other.clear();
+    return *this;
+}
+
+void* CommandBuffer::allocate(size_t size, size_t alignment)
+{
+    while (true) {
+        if (m_current_block < m_blocks.size()) {
+            auto& block = m_blocks[m_current_block];
+            auto base = reinterpret_cast<uintptr_t>(block.data.get());
+            auto aligned = (base + m_block_offset + alignment - 1) / alignment * alignment;
+
+            if (aligned + size <= base + block.size) {
+                m_block_offset = aligned + size - base;
+                return reinterpret_cast<void*>(aligned);
+            }
+
+            // Blocks that are too small for this value are skipped, not resized,
+            // so earlier values never move.
+            m_current_block++;
+            m_block_offset = 0;
+            continue;
+        }
+
+        auto block_bytes = std::max(block_size, size + alignment);
+        m_blocks.push_back(Block {
+            .data = std::make_unique<std::byte[]>(block_bytes),
+            .size = block_bytes,
+        });
+    }
+}
+
+void CommandBuffer::apply(Registry& reg)
+{
+    std::span<Command const> commands(m_commands);
+
+    size_t begin = 0;
+    while (begin < commands.size()) {
+        auto& first = commands[begin];
+        auto end = begin + 1;
+
+        while (end < commands.size()
+            && commands[end].kind == first.kind
+            && commands[end].component == first.component) {
+            end++;
+        }
+
+        auto run = commands.subspan(begin, end - begin);
+
+        switch (first.kind) {
+        case CommandKind::Spawn:
+            apply_spawns(reg, run);
+            break;
+
+        case CommandKind::Despawn:
+            apply_despawns(reg, run);
+            break;
+
+        case CommandKind::AddComponent:
+        case CommandKind::RemoveComponent:
+            apply_component_changes(reg, run);
+            break;
+        }
+
+        begin = end;
+    }
+
+    clear();
+}
+
+void CommandBuffer::apply_spawns(Registry& reg, std::span<Command const> commands)
+{
+    m_order.resize(commands.size());
+    for (uint32_t i = 0; i < commands.size(); i++) {
+        m_order[i] = i;
+    }
+
+    // Spawns of the same component set share an archetype resolver.
+    std::stable_sort(m_order.begin(), m_order.end(), [&](auto a, auto b) {
+        return reinterpret_cast<uintptr_t>(commands[a].archetype) < reinterpret_cast<uintptr_t>(commands[b].archetype);
+    });
+
+    size_t group_begin = 0;
+    while (group_begin < m_order.size()) {
+        auto& first = commands[m_order[group_begin]];
+
+        auto group_end = group_begin + 1;
+        while (group_end < m_order.size() && commands[m_order[group_end]].archetype == first.archetype) {
+            group_end++;
+        }
+
+        auto& archetype = first.archetype(reg);
+        archetype.reserve(archetype.size() + (group_end - group_begin));
+
+        for (auto i = group_begin; i < group_end; i++) {
+            auto& command = commands[m_order[i]];
+
+            auto id = reg.m_id_allocator.allocate();
+            auto row = archetype.push_row_uninitialized(id, reg.change_tick());
+
+            for (size_t c = 0; c < command.spawn_component_count; c++) {
+                auto& info = *command.spawn_components[c];
+                auto payload = m_spawn_payloads[command.first_spawn_payload + c];
+
+                if (info.storage == StoragePolicy::Sparse) {
+                    auto storage = reg.sparse_set(info).emplace_uninitialized(id, reg.change_tick());
+
+                    if (!info.is_tag) {
+                        relocate_component(info, storage, payload);
+                    }
+
+                    continue;
+                }
+
+                if (info.is_tag) {
+                    continue;
+                }
+
+                relocate_component(info, archetype.at(archetype.column_index(info.id), row), payload);
+            }
+
+            reg.set_location(id, EntityLocation {
+                .archetype = &archetype,
+                .row = row,
+            });
+        }
+
+        group_begin = group_end;
+    }
+}
+
+void CommandBuffer::apply_despawns(Registry& reg, std::span<Command const> commands)
+{
+    for (auto& command : commands) {
+        if (reg.is_alive(command.entity)) {
+            reg.despawn(command.entity);
+        }
+    }
+}
+
+void CommandBuffer::apply_component_changes(Registry& reg, std::span<Command const> commands)
+{
+    auto& info = *commands[0].component;
+    bool is_add = commands[0].kind == CommandKind::AddComponent;
+
+    if (info.storage == StoragePolicy::Sparse) {
+        apply_sparse_changes(reg, commands);
+        return;
+    }
+
+    m_order.clear();
+
+    for (uint32_t i = 0; i < commands.size(); i++) {
+        if (reg.is_alive(commands[i].entity)) {
+            m_order.push_back(i);
+        } else if (is_add) {
+            destroy_component(info, commands[i].payload);
+        }
+    }
+
+    std::stable_sort(m_order.begin(), m_order.end(), [&](auto a, auto b) {
+        return reg.location_of(commands[a].entity).archetype < reg.location_of(commands[b].entity).archetype;
+    });
+
+    // Applies a single command without relying on the group's cached source
+    // and target, e.g. when the entity was already moved earlier in the run.
+    auto apply_one = [&](Command const& command) {
+        auto& location = reg.location_of(command.entity);
+        auto& source = *location.archetype;
+        auto column = source.column_index(info.id);
+
+        if (!is_add) {
+            if (column != Archetype::no_column) {
+                reg.move_entity(command.entity, reg.archetype_without(source, info.id));
+            }
+
+            return;
+        }
+
+        if (column == Archetype::tag_column) {
+            return;
+        }
+
+        if (column != Archetype::no_column) {
+            destroy_component(info, source.at(column, location.row));
+            relocate_component(info, source.at(column, location.row), command.payload);
+            source.changed_tick_at(column, location.row) = reg.change_tick();
+            return;
+        }
+
+        auto& target = reg.archetype_with(source, info);
+        auto row = reg.move_entity(command.entity, target);
+
+        if (!info.is_tag) {
+            relocate_component(info, target.at(target.column_index(info.id), row), command.payload);
+        }
+    };
+
+    size_t group_begin = 0;
+    while (group_begin < m_order.size()) {
+        auto source = reg.location_of(commands[m_order[group_begin]].entity).archetype;
+
+        auto group_end = group_begin + 1;
+        while (group_end < m_order.size() && reg.location_of(commands[m_order[group_end]].entity).archetype == source) {
+            group_end++;
+        }
+
+        // Nothing moves if the component is already present (add) or absent (remove).
+        if (is_add == source->has_component(info.id)) {
+            for (auto i = group_begin; i < group_end; i++) {
+                apply_one(commands[m_order[i]]);
+            }
+
+            group_begin = group_end;
+            continue;
+        }
+
+        auto& target = is_add ? reg.archetype_with(*source, info) : reg.archetype_without(*source, info.id);
+        auto target_column = target.column_index(info.id);
+
+        target.reserve(target.size() + (group_end - group_begin));
+
+        for (auto i = group_begin; i < group_end; i++) {
+            auto& command = commands[m_order[i]];
+
+            if (reg.location_of(command.entity).archetype != source) {
+                apply_one(command);
+                continue;
+            }
+
+            auto row = reg.move_entity(command.entity, target);
+
+            if (is_add && !info.is_tag) {
+                relocate_component(info, target.at(target_column, row), command.payload);
+            }
+        }
+
+        group_begin = group_end;
+    }
+}
+
+// Sparse components never move entities between archetypes, so there is
+// nothing to group.
+void CommandBuffer::apply_sparse_changes(Registry& reg, std::span<Command const> commands)
+{
+    auto& info = *commands[0].component;
+    bool is_add = commands[0].kind == CommandKind::AddComponent;
+    auto& set = reg.sparse_set(info);
+
+    for (auto& command : commands) {
+        if (!reg.is_alive(command.entity)) {
+            if (is_add) {
+                destroy_component(info, command.payload);
+            }
+
+            continue;
+        }
+
+        if (!is_add) {
+            set.remove(command.entity);
+            continue;
+        }
+
+        auto dense = set.find(command.entity);
+
+        if (dense == SparseSet::npos) {
+            auto storage = set.emplace_uninitialized(command.entity, reg.change_tick());
+
+            if (!info.is_tag) {
+                relocate_component(info, storage, command.payload);
+            }
+        } else if (!info.is_tag) {
+            destroy_component(info, set.at(dense));
+            relocate_component(info, set.at(dense), command.payload);
+            set.changed_tick_at(dense) = reg.change_tick();
+        }
+    }
+}
+
+void CommandBuffer::destroy_payloads()
+{
+    for (auto& command : m_commands) {
+        switch (command.kind) {
+        case CommandKind::Spawn:
+            for (size_t c = 0; c < command.spawn_component_count; c++) {
+                destroy_component(*command.spawn_components[c], m_spawn_payloads[command.first_spawn_payload + c]);
+            }
+            break;
+
+        case CommandKind::AddComponent:
+            destroy_component(*command.component, command.payload);
+            break;
+
+        default:
+            break;
+        }
+    }
+}
+
+void CommandBuffer::clear()
+{
+    m_commands.clear();
+    m_spawn_payloads.clear();
+    m_current_block = 0;
+    m_block_offset = 0;
+}
+}
@@ -0,0 +1,188 @@
+#pragma once
+
+#include <kata/core/job_system.hpp>
+#include <kata/ecs/component.hpp>
+#include <kata/ecs/id_allocator.hpp>
+#include <kata/ecs/registry.hpp>
+#include <memory>
+#include <vector>
+
+namespace kata {
+// Records structural changes (spawn, despawn, add/remove component) so they
+// can be made while a query is running, and applies them later at a sync
+// point. Component values are kept in an arena that is reused after every
+// apply(), so steady-state recording doesn't allocate.
+class CommandBuffer {
+public:
+    CommandBuffer() = default;
+    ~CommandBuffer();
+
+    CommandBuffer(CommandBuffer const&) = delete;
+    CommandBuffer& operator=(CommandBuffer const&) = delete;
+
+    // The moved-from buffer is left empty. Assigning over a buffer destroys
+    // the component values it hadn't applied yet.
+    CommandBuffer(CommandBuffer&& other);
+    CommandBuffer& operator=(CommandBuffer&& other);
+
+    template<typename... Components>
+    void spawn(Components... components)
+    {
+        static ComponentInfo const* const infos[] { &component_info<Components>()... };
+
+        auto first_payload = m_spawn_payloads.size();
+        (m_spawn_payloads.push_back(store(std::move(components))), ...);
+
+        m_commands.push_back(Command {
+            .kind = CommandKind::Spawn,
+            .archetype = [](Registry& reg) -> Archetype& {
+                return reg.archetype_for<Components...>();
+            },
+            .spawn_components = infos,
+            .spawn_component_count = sizeof...(Components),
+            .first_spawn_payload = first_payload,
+        });
+    }
+
+    void despawn(EntityID id)
+    {
+        m_commands.push_back(Command {
+            .kind = CommandKind::Despawn,
+            .entity = id,
+        });
+    }
+
+    template<typename T>
+    void add_component(EntityID id, T component)
+    {
+        m_commands.push_back(Command {
+            .kind = CommandKind::AddComponent,
+            .entity = id,
+            .component = &component_info<T>(),
+            .payload = store(std::move(component)),
+        });
+    }
+
+    template<typename T>
+    void remove_component(EntityID id)
+    {
+        m_commands.push_back(Command {
+            .kind = CommandKind::RemoveComponent,
+            .entity = id,
+            .component = &component_info<T>(),
+        });
+    }
+
+    bool is_empty() const
+    {
+        return m_commands.empty();
+    }
+
+    // Applies all recorded commands in order and clears the buffer.
+    //
+    // Consecutive commands of the same kind (and for add/remove, the same
+    // component) are applied as a batch: entities are grouped by their
+    // current archetype, so the destination is resolved and reserved once
+    // per group. Commands targeting entities that are dead by the time they
+    // are applied are dropped.
+    void apply(Registry& reg);
+
+private:
+    enum class CommandKind : uint8_t {
+        Spawn,
+        Despawn,
+        AddComponent,
+        RemoveComponent,
+    };
+
+    struct Command {
+        CommandKind kind {};
+        EntityID entity { null_entity };
+
+        // AddComponent / RemoveComponent
+        ComponentInfo const* component { nullptr };
+        void* payload { nullptr };
+
+        // Spawn
+        Archetype& (*archetype)(Registry&) { nullptr };
+        ComponentInfo const* const* spawn_components { nullptr };
+        size_t spawn_component_count {};
+        size_t first_spawn_payload {};
+    };
+
+    // Tags have nothing to store and get a null payload.
+    template<typename T>
+    void* store(T value)
+    {
+        if constexpr (is_tag_component<T>) {
+            return nullptr;
+        }
+
+        auto ptr = allocate(sizeof(T), alignof(T));
+        new (ptr) T(std::move(value));
+        return ptr;
+    }
+
+    void* allocate(size_t size, size_t alignment);
+
+    void apply_spawns(Registry& reg, std::span<Command const> commands);
+    void apply_despawns(Registry& reg, std::span<Command const> commands);
+    void apply_component_changes(Registry& reg, std::span<Command const> commands);
+    void apply_sparse_changes(Registry& reg, std::span<Command const> commands);
+
+    // Destroys the component values of commands that were never applied.
+    void destroy_payloads();
+    void clear();
+
+    struct Block {
+        std::unique_ptr<std::byte[]> data {};
+        size_t size {};
+    };
+
+    static constexpr size_t block_size = 16 * 1024;
+
+    std::vector<Command> m_commands {};
+    std::vector<void*> m_spawn_payloads {};
+
+    std::vector<Block> m_blocks {};
+    size_t m_current_block {};
+    size_t m_block_offset {};
+
+    // Scratch space for apply(), kept to avoid reallocating.
+    std::vector<uint32_t> m_order {};
+};
+
+// One CommandBuffer per job system thread, so commands can be recorded from
+// par_query callbacks and concurrently running systems without locking.
+class ParallelCommandBuffer {
+public:
+    explicit ParallelCommandBuffer(JobSystem& jobs = JobSystem::shared())
+        : m_jobs(&jobs)
+        , m_slots(jobs.worker_count() + 1)
+    {
+    }
+
+    // The calling thread's buffer.
+    CommandBuffer& local()
+    {
+        return m_slots[m_jobs->current_thread_slot()].buffer;
+    }
+
+    // Applies every thread's buffer, in thread slot order.
+    void apply(Registry& reg)
+    {
+        for (auto& slot : m_slots) {
+            slot.buffer.apply(reg);
+        }
+    }
+
+private:
+    // Padded so that threads recording into neighbouring buffers don't share cache lines.
+    struct alignas(64) Slot {
+        CommandBuffer buffer {};
+    };
+
+    JobSystem* m_jobs { nullptr };
+    std::vector<Slot> m_slots {};
+};
+}
@@ -0,0 +1,43 @@
+#include <deque>
+#include <kata/ecs/component.hpp>
+#include <mutex>
+
+namespace kata::detail {
+// Function-local statics, so components can be registered during static initialization.
+static std::mutex& components_mutex()
+{
+    static std::mutex mutex {};
+    return mutex;
+}
+
+static std::deque<ComponentInfo>& components()
+{
+    // std::deque never moves existing elements on push_back, so handed out
+    // pointers stay valid for the lifetime of the program.
+    static std::deque<ComponentInfo> components {};
+    return components;
+}
+
+ComponentInfo const* register_component(ComponentInfo info)
+{
+    std::scoped_lock lock(components_mutex());
+
+    info.id = ComponentID(components().size());
+    components().push_back(info);
+
+    return &components().back();
+}
+
+ComponentInfo const* find_component(std::string_view name)
+{
+    std::scoped_lock lock(components_mutex());
+
+    for (auto const& info : components()) {
+        if (info.name == name) {
+            return &info;
+        }
+    }
+
+    return nullptr;
+}
+}
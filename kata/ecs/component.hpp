@@ -0,0 +1,208 @@
+#pragma once
+
+#include <assert.h>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+namespace kata {
+using ComponentID = uint32_t;
+
+class SnapshotReader;
+class SnapshotWriter;
+
+// Empty component types are tags: they only take part in archetype
+// signatures and never get a column, so they cost nothing per row.
+template<typename T>
+constexpr bool is_tag_component = std::is_empty_v<T> && std::is_trivially_copyable_v<T>;
+
+// Where a component's values live. Table components are archetype columns:
+// iterating them is fastest, but adding or removing one moves the whole row
+// to another archetype. Sparse components live in a per-component SparseSet
+// keyed by entity, which makes adding and removing them cheap at the cost of
+// a lookup per row in queries. Components opt in with
+// `static constexpr auto storage = StoragePolicy::Sparse;`.
+enum class StoragePolicy : uint8_t {
+    Table,
+    Sparse,
+};
+
+template<typename T>
+constexpr StoragePolicy storage_policy = StoragePolicy::Table;
+
+template<typename T>
+    requires requires { T::storage; }
+constexpr StoragePolicy storage_policy<T> = T::storage;
+
+template<typename T>
+constexpr bool is_sparse_component = storage_policy<T> == StoragePolicy::Sparse;
+
+// Snapshots store trivially copyable components as raw bytes. Other
+// components have to provide their own encoding to be saved:
+//
+//     void save(SnapshotWriter& writer) const;
+//     static T load(SnapshotReader& reader);
+template<typename T>
+concept SnapshotSerializable = requires(T const& value, SnapshotWriter& writer, SnapshotReader& reader) {
+    value.save(writer);
+    { T::load(reader) } -> std::same_as<T>;
+};
+
+// Type-erased description of a component type. Archetype columns only ever see
+// raw bytes, so everything they need to know about T lives here.
+struct ComponentInfo {
+    // Move-constructs an object at `dst` from `src` and destroys `src`.
+    using RelocateFn = void (*)(void* dst, void* src);
+    using DestroyFn = void (*)(void* ptr);
+    // Copy-constructs an object at `dst` from `src`.
+    using CopyFn = void (*)(void* dst, void const* src);
+    // Snapshot encoding of SnapshotSerializable components. LoadFn constructs
+    // the component at `dst`.
+    using SaveFn = void (*)(SnapshotWriter& writer, void const* ptr);
+    using LoadFn = void (*)(SnapshotReader& reader, void* dst);
+
+    ComponentID id {};
+    // For diagnostics only; the ECS identifies types by `id`, not by RTTI.
+    std::string_view name {};
+    size_t size {};
+    size_t alignment {};
+    RelocateFn relocate { nullptr };
+    DestroyFn destroy { nullptr };
+    // nullptr for types that aren't copy constructible.
+    CopyFn copy { nullptr };
+    SaveFn save { nullptr };
+    LoadFn load { nullptr };
+
+    // Trivially copyable components are relocated with memcpy and never destroyed.
+    bool is_trivially_copyable {};
+    bool is_tag {};
+    StoragePolicy storage {};
+};
+
+namespace detail {
+ComponentInfo const* register_component(ComponentInfo info);
+
+// Looks up a registered component by its name, or returns nullptr.
+ComponentInfo const* find_component(std::string_view name);
+
+// Name of T as spelled by the compiler, extracted from the function signature
+// so that it doesn't need RTTI.
+template<typename T>
+constexpr std::string_view type_name()
+{
+#if defined(_MSC_VER)
+    std::string_view signature = __FUNCSIG__;
+    auto begin = signature.find("type_name<") + std::string_view("type_name<").size();
+    auto end = signature.rfind(">(void)");
+#else
+    std::string_view signature = __PRETTY_FUNCTION__;
+    auto begin = signature.find("T = ") + std::string_view("T = ").size();
+    auto end = signature.find_first_of(";]", begin);
+#endif
+
+    return signature.substr(begin, end - begin);
+}
+
+template<typename T>
+ComponentInfo make_component_info()
+{
+    auto info = ComponentInfo {
+        .name = type_name<T>(),
+        .size = sizeof(T),
+        .alignment = alignof(T),
+        .relocate = [](void* dst, void* src) {
+            auto* source = static_cast<T*>(src);
+            new (dst) T(std::move(*source));
+            source->~T();
+        },
+        .destroy = [](void* ptr) {
+            static_cast<T*>(ptr)->~T();
+        },
+        .is_trivially_copyable = std::is_trivially_copyable_v<T>,
+        .is_tag = is_tag_component<T>,
+        .storage = storage_policy<T>,
+    };
+
+    if constexpr (std::is_copy_constructible_v<T>) {
+        info.copy = [](void* dst, void const* src) {
+            new (dst) T(*static_cast<T const*>(src));
+        };
+    }
+
+    if constexpr (SnapshotSerializable<T>) {
+        info.save = [](SnapshotWriter& writer, void const* ptr) {
+            static_cast<T const*>(ptr)->save(writer);
+        };
+        info.load = [](SnapshotReader& reader, void* dst) {
+            new (dst) T(T::load(reader));
+        };
+    }
+
+    return info;
+}
+
+// Tags have no storage; get() and queries hand out this shared instance.
+template<typename T>
+T& tag_instance()
+{
+    static T instance {};
+
+    return instance;
+}
+}
+
+template<typename T>
+ComponentInfo const& component_info()
+{
+    // `T const` and `T&` must share the registration of T.
+    if constexpr (!std::is_same_v<T, std::remove_cvref_t<T>>) {
+        return component_info<std::remove_cvref_t<T>>();
+    } else {
+        static ComponentInfo const* info = detail::register_component(detail::make_component_info<T>());
+
+        return *info;
+    }
+}
+
+template<typename T>
+ComponentID component_id()
+{
+    return component_info<T>().id;
+}
+
+// Moves the component at `src` to uninitialized storage at `dst`, leaving
+// `src` destroyed.
+inline void relocate_component(ComponentInfo const& info, void* dst, void* src)
+{
+    if (info.is_trivially_copyable) {
+        std::memcpy(dst, src, info.size);
+        return;
+    }
+
+    info.relocate(dst, src);
+}
+
+// Copy-constructs the component at `src` into uninitialized storage at `dst`.
+inline void copy_component(ComponentInfo const& info, void* dst, void const* src)
+{
+    if (info.is_trivially_copyable) {
+        std::memcpy(dst, src, info.size);
+        return;
+    }
+
+    assert(info.copy && "component isn't copy constructible");
+    info.copy(dst, src);
+}
+
+inline void destroy_component(ComponentInfo const& info, void* ptr)
+{
+    if (!info.is_trivially_copyable) {
+        info.destroy(ptr);
+    }
+}
+}
@@ -0,0 +1,169 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <kata/core/job_system.hpp>
+#include <utility>
+#include <vector>
+
+namespace kata {
+class EventChannelBase {
+public:
+    virtual ~EventChannelBase() = default;
+
+    // Starts a new frame, see Events::update().
+    virtual void update() = 0;
+};
+
+template<typename T>
+class Events;
+
+// Remembers which events of a channel one consumer has already seen, so
+// that Events::read() hands out every event exactly once even though events
+// stay readable for two frames.
+template<typename T>
+class EventReader {
+public:
+    EventReader() = default;
+
+private:
+    friend class Events<T>;
+
+    // The channel frame at the last read, and how many events of each
+    // thread slot of that frame's buffer were read.
+    uint64_t m_frame { UINT64_MAX };
+    std::vector<size_t> m_read {};
+};
+
+// Typed event channel, double buffered per frame: events sent during frame
+// N can be read until the end of frame N + 1, so consumers running before
+// the producer in a frame still see them one frame later.
+//
+// Every thread appends to its own buffer (indexed by
+// JobSystem::current_thread_slot()), so send() never locks or contends,
+// even from par_query(). Buffers are cleared but never shrunk, so a channel
+// stops allocating once it has seen its peak frame.
+//
+// Sending may run concurrently with other sends, but not with reads or
+// update(); see SystemAccess::send_events() and read_events().
+template<typename T>
+class Events : public EventChannelBase {
+public:
+    explicit Events(JobSystem& jobs = JobSystem::shared())
+        : m_jobs(&jobs)
+    {
+        for (auto& buffer : m_buffers) {
+            buffer.resize(jobs.worker_count() + 1);
+        }
+    }
+
+    void send(T event)
+    {
+        current()[m_jobs->current_thread_slot()].events.push_back(std::move(event));
+    }
+
+    // Calls f(event) for every event sent since `reader` last read this
+    // channel, oldest frame first. Events older than the previous frame are
+    // gone and silently skipped.
+    template<typename F>
+    void read(EventReader<T>& reader, F f) const
+    {
+        auto& previous_buffer = m_buffers[m_current ^ 1];
+        auto& current_buffer = m_buffers[m_current];
+
+        if (reader.m_read.size() != current_buffer.size()) {
+            reader.m_read.assign(current_buffer.size(), 0);
+        }
+
+        // Whatever the reader saw of the previous buffer: everything if it
+        // was already previous at the last read, nothing if the last read
+        // was longer ago.
+        auto skip = [&](uint64_t frame, size_t slot) -> size_t {
+            if (reader.m_frame == frame) {
+                return reader.m_read[slot];
+            }
+
+            return reader.m_frame != UINT64_MAX && reader.m_frame > frame ? SIZE_MAX : 0;
+        };
+
+        if (m_frame > 0) {
+            for (size_t slot = 0; slot < previous_buffer.size(); slot++) {
+                auto& events = previous_buffer[slot].events;
+
+                for (auto i = std::min(skip(m_frame - 1, slot), events.size()); i < events.size(); i++) {
+                    f(events[i]);
+                }
+            }
+        }
+
+        for (size_t slot = 0; slot < current_buffer.size(); slot++) {
+            auto& events = current_buffer[slot].events;
+
+            for (auto i = std::min(skip(m_frame, slot), events.size()); i < events.size(); i++) {
+                f(events[i]);
+            }
+
+            reader.m_read[slot] = events.size();
+        }
+
+        reader.m_frame = m_frame;
+    }
+
+    // Calls f(event) for every event of the previous and the current frame.
+    template<typename F>
+    void for_each(F f) const
+    {
+        for (auto buffer : { m_current ^ 1, m_current }) {
+            for (auto const& slot : m_buffers[buffer]) {
+                for (auto const& event : slot.events) {
+                    f(event);
+                }
+            }
+        }
+    }
+
+    // Number of events of the previous and the current frame.
+    size_t size() const
+    {
+        size_t size = 0;
+
+        for (auto const& buffer : m_buffers) {
+            for (auto const& slot : buffer) {
+                size += slot.events.size();
+            }
+        }
+
+        return size;
+    }
+
+    // Drops the previous frame's events and starts a new frame. Called by
+    // Registry::advance_tick() for channels owned by the registry.
+    virtual void update() override
+    {
+        m_current ^= 1;
+        m_frame++;
+
+        for (auto& slot : current()) {
+            slot.events.clear();
+        }
+    }
+
+private:
+    // Padded so that threads sending from neighbouring slots don't share cache lines.
+    struct alignas(64) Slot {
+        std::vector<T> events {};
+    };
+
+    std::vector<Slot>& current()
+    {
+        return m_buffers[m_current];
+    }
+
+    JobSystem* m_jobs { nullptr };
+    std::array<std::vector<Slot>, 2> m_buffers {};
+    size_t m_current {};
+    uint64_t m_frame {};
+};
+}
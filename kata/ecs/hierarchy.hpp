@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <kata/ecs/id_allocator.hpp>
+#include <kata/ecs/serialization.hpp>
+#include <span>
+#include <vector>
+
+namespace kata {
+// Hierarchy components. Both are maintained by Registry::set_parent(),
+// remove_parent() and despawn(); don't add or modify them directly.
+
+struct Parent {
+    EntityID entity { null_entity };
+    // Number of ancestors, so 1 for children of a root.
+    uint32_t depth {};
+};
+
+struct Children {
+    std::vector<EntityID> entities {};
+
+    void save(SnapshotWriter& writer) const
+    {
+        writer.write_span(std::span<EntityID const>(entities));
+    }
+
+    static Children load(SnapshotReader& reader)
+    {
+        auto bytes = reader.read_span(sizeof(EntityID));
+
+        Children children;
+        children.entities.resize(bytes.size() / sizeof(EntityID));
+
+        if (!bytes.empty()) {
+            std::memcpy(children.entities.data(), bytes.data(), bytes.size());
+        }
+
+        return children;
+    }
+};
+}
@@ -1,16 +1,56 @@
+#include <algorithm>
+#include <assert.h>
 #include <kata/ecs/id_allocator.hpp>
 
 namespace kata {
 EntityID IDAllocator::allocate()
 {
-    m_last_id++;
+    if (!m_free_indices.empty()) {
+        auto index = m_free_indices.back();
+        m_free_indices.pop_back();
 
-    return m_last_id;
+        return make_entity_id(index, m_generations[index]);
+    }
+
+    auto index = uint32_t(m_generations.size());
+    m_generations.push_back(EntityRange::generation);
+
+    return make_entity_id(index, EntityRange::generation);
 }
 
-void IDAllocator::free(EntityID)
+EntityRange IDAllocator::allocate_range(size_t count)
 {
-    // FIXME: ID could be generational (32-bit ID + 32-bit generation index),
-    //        but flat uint64_t range seems to be good enough.
+    auto recycled_count = std::min(count, m_free_indices.size());
+    auto first_recycled = m_free_indices.end() - std::ptrdiff_t(recycled_count);
+
+    std::vector<EntityID> recycled;
+    recycled.reserve(recycled_count);
+
+    for (auto it = first_recycled; it != m_free_indices.end(); it++) {
+        recycled.push_back(make_entity_id(*it, m_generations[*it]));
+    }
+
+    m_free_indices.erase(first_recycled, m_free_indices.end());
+
+    auto first = uint32_t(m_generations.size());
+    auto fresh_count = count - recycled_count;
+    m_generations.resize(m_generations.size() + fresh_count, EntityRange::generation);
+
+    return EntityRange(std::move(recycled), first, uint32_t(fresh_count));
+}
+
+void IDAllocator::free(EntityID id)
+{
+    assert(is_alive(id));
+
+    auto index = entity_index(id);
+    auto& generation = m_generations[index];
+
+    // Skip 0 on wrap-around to keep null_entity invalid.
+    if (++generation == 0) {
+        generation = 1;
+    }
+
+    m_free_indices.push_back(index);
 }
 }
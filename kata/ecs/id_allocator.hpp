@@ -1,10 +1,126 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
+#include <span>
+#include <utility>
+#include <vector>
 
 namespace kata {
+// Low 32 bits are the entity index, high 32 bits are the generation of that
+// index. Indices are recycled; the generation tells stale handles apart.
 using EntityID = uint64_t;
 
+// Generations start at 1, so 0 is never a valid entity.
+constexpr EntityID null_entity = 0;
+
+// Slot of the entity in dense, ID-indexed side tables.
+inline uint32_t entity_index(EntityID id)
+{
+    return uint32_t(id);
+}
+
+inline uint32_t entity_generation(EntityID id)
+{
+    return uint32_t(id >> 32);
+}
+
+inline EntityID make_entity_id(uint32_t index, uint32_t generation)
+{
+    return (EntityID(generation) << 32) | index;
+}
+
+// Entities allocated together: recycled IDs first, then `count` fresh
+// entities with consecutive indices. Only the recycled part is stored, so a
+// range of fresh entities costs nothing per entity.
+class EntityRange {
+public:
+    class Iterator {
+    public:
+        using value_type = EntityID;
+        using difference_type = std::ptrdiff_t;
+
+        Iterator() = default;
+
+        Iterator(EntityRange const* range, size_t position)
+            : m_range(range)
+            , m_position(position)
+        {
+        }
+
+        EntityID operator*() const
+        {
+            return (*m_range)[m_position];
+        }
+
+        Iterator& operator++()
+        {
+            m_position++;
+            return *this;
+        }
+
+        Iterator operator++(int)
+        {
+            auto copy = *this;
+            m_position++;
+            return copy;
+        }
+
+        bool operator==(Iterator const&) const = default;
+
+    private:
+        EntityRange const* m_range { nullptr };
+        size_t m_position {};
+    };
+
+    // Fresh indices always start at the first generation.
+    static constexpr uint32_t generation = 1;
+
+    EntityRange() = default;
+
+    EntityRange(uint32_t first_index, uint32_t count)
+        : m_first_index(first_index)
+        , m_count(count)
+    {
+    }
+
+    EntityRange(std::vector<EntityID> recycled, uint32_t first_index, uint32_t count)
+        : m_recycled(std::move(recycled))
+        , m_first_index(first_index)
+        , m_count(count)
+    {
+    }
+
+    size_t size() const
+    {
+        return m_recycled.size() + m_count;
+    }
+
+    EntityID operator[](size_t i) const
+    {
+        if (i < m_recycled.size()) {
+            return m_recycled[i];
+        }
+
+        return make_entity_id(m_first_index + uint32_t(i - m_recycled.size()), generation);
+    }
+
+    Iterator begin() const
+    {
+        return Iterator(this, 0);
+    }
+
+    Iterator end() const
+    {
+        return Iterator(this, size());
+    }
+
+private:
+    std::vector<EntityID> m_recycled {};
+    uint32_t m_first_index {};
+    uint32_t m_count {};
+};
+
 class IDAllocator {
 public:
     IDAllocator() = default;
@@ -12,7 +128,45 @@ public:
     EntityID allocate();
     void free(EntityID id);
 
+    // Allocates `count` IDs, reusing freed indices before growing the index
+    // space, so batch spawns don't grow ID-indexed tables under churn. Freed
+    // indices are taken in the order they were freed, which gives a
+    // despawned batch back its ascending indices.
+    EntityRange allocate_range(size_t count);
+
+    // One past the highest index handed out so far.
+    uint32_t index_end() const
+    {
+        return uint32_t(m_generations.size());
+    }
+
+    bool is_alive(EntityID id) const
+    {
+        auto index = entity_index(id);
+
+        return index < m_generations.size() && m_generations[index] == entity_generation(id);
+    }
+
+    // Raw allocator state, for snapshots. restore() replaces the current
+    // state, so it must only be used on an allocator nothing refers to yet.
+    std::span<uint32_t const> generations() const
+    {
+        return m_generations;
+    }
+
+    std::span<uint32_t const> free_indices() const
+    {
+        return m_free_indices;
+    }
+
+    void restore(std::vector<uint32_t> generations, std::vector<uint32_t> free_indices)
+    {
+        m_generations = std::move(generations);
+        m_free_indices = std::move(free_indices);
+    }
+
 private:
-    EntityID m_last_id { 0 };
+    std::vector<uint32_t> m_generations {};
+    std::vector<uint32_t> m_free_indices {};
 };
 }
@@ -0,0 +1,8 @@
+#pragma once
+
+namespace kata {
+// Marks an entity as a prefab: a template for Registry::instantiate() rather
+// than a live entity. Queries skip prefabs unless they name Prefab in one of
+// their terms (e.g. With<Prefab>), so systems never update them.
+struct Prefab { };
+}
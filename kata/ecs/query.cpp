@@ -0,0 +1,55 @@
+#include <algorithm>
+#include <kata/ecs/prefab.hpp>
+#include <kata/ecs/query.hpp>
+
+namespace kata {
+QueryCache::QueryCache(std::span<ComponentID const> key)
+{
+    assert(key.size() % 2 == 0);
+
+    auto term_count = key.size() / 2;
+    m_components.assign(key.begin(), key.begin() + term_count);
+
+    for (size_t i = 0; i < term_count; i++) {
+        auto presence = TermPresence(key[term_count + i]);
+
+        if (presence == TermPresence::Required) {
+            m_required.set(m_components[i]);
+        } else if (presence == TermPresence::Excluded) {
+            m_excluded.set(m_components[i]);
+        }
+    }
+
+    auto prefab = component_id<Prefab>();
+    if (std::find(m_components.begin(), m_components.end(), prefab) == m_components.end()) {
+        m_excluded.set(prefab);
+    }
+}
+
+void QueryCache::try_add(Archetype& archetype)
+{
+    if (!matches(archetype)) {
+        return;
+    }
+
+    m_archetypes.push_back(&archetype);
+
+    for (auto id : m_components) {
+        m_columns.push_back(archetype.column_index(id));
+    }
+}
+
+void QueryCache::remove(Archetype const& archetype)
+{
+    auto it = std::find(m_archetypes.begin(), m_archetypes.end(), &archetype);
+    if (it == m_archetypes.end()) {
+        return;
+    }
+
+    auto index = size_t(it - m_archetypes.begin());
+    auto columns = m_columns.begin() + index * m_components.size();
+
+    m_archetypes.erase(it);
+    m_columns.erase(columns, columns + m_components.size());
+}
+}
@@ -0,0 +1,601 @@
+#pragma once
+
+#include <algorithm>
+#include <kata/ecs/archetype.hpp>
+#include <kata/ecs/component.hpp>
+#include <kata/ecs/sparse_set.hpp>
+#include <span>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace kata {
+// Query filters: restrict the rows a query visits without passing the
+// component to the callback. They match rows touched within the query's
+// QueryTicks: by default since the last Registry::advance_tick(), or since a
+// ChangeTracker's previous window (see Registry::track_changes()).
+
+// Matches rows whose T was added or handed out mutably.
+template<typename T>
+struct Changed { };
+
+// Matches rows whose T was added.
+template<typename T>
+struct Added { };
+
+// Archetype filters: decided once per archetype when the query cache is
+// built, so they cost nothing per row.
+
+// Matches entities that have T, without fetching it.
+template<typename T>
+struct With { };
+
+// Matches entities that don't have T.
+template<typename T>
+struct Without { };
+
+// Passes a pointer to T, or nullptr for entities without it. `Optional<T
+// const>` is read-only.
+template<typename T>
+struct Optional { };
+
+// Passes the row's EntityID. Matches every entity.
+struct Entity { };
+
+// How a query term restricts the archetypes a query matches. Terms on sparse
+// components are Optional at the archetype level and filtered per row.
+enum class TermPresence : uint8_t {
+    Required,
+    Excluded,
+    Optional,
+};
+
+// Ticks a query runs with: rows are bumped to `current` when handed out
+// mutably, and filters match rows in (`last`, `current`].
+struct QueryTicks {
+    ChangeTick current {};
+    ChangeTick last {};
+
+    bool contains(ChangeTick tick) const
+    {
+        return tick > last && tick <= current;
+    }
+};
+
+// Remembers up to which tick one consumer, typically a system, has seen
+// changes. Filters in queries run with its window match every change since
+// the consumer's previous window, wherever the writers ran in the frame; with
+// the default window, changes made after the consumer ran in the previous
+// frame would be missed.
+class ChangeTracker {
+public:
+    ChangeTracker() = default;
+
+private:
+    friend class Registry;
+
+    ChangeTick m_last_tick {};
+};
+
+// Archetypes matching a query, together with the resolved column indices of
+// the queried components. Built once per distinct query and then updated
+// incrementally as archetypes get created.
+//
+// A query is identified by its key: the component ID of every term in query
+// order (not sorted, so that column indices line up with the callback
+// arguments), followed by every term's TermPresence.
+class QueryCache {
+public:
+    explicit QueryCache(std::span<ComponentID const> key);
+
+    // Whether `archetype` has every required and none of the excluded components.
+    bool matches(Archetype const& archetype) const
+    {
+        return archetype.mask().contains(m_required) && !archetype.mask().intersects(m_excluded);
+    }
+
+    // Adds `archetype` if it matches.
+    void try_add(Archetype& archetype);
+
+    // Forgets `archetype` if it was matched, e.g. before it's destroyed.
+    void remove(Archetype const& archetype);
+
+    size_t archetype_count() const
+    {
+        return m_archetypes.size();
+    }
+
+    Archetype& archetype(size_t index)
+    {
+        return *m_archetypes[index];
+    }
+
+    // Total number of rows of the matched archetypes.
+    size_t row_count() const
+    {
+        size_t rows = 0;
+
+        for (auto archetype : m_archetypes) {
+            rows += archetype->size();
+        }
+
+        return rows;
+    }
+
+    // Column indices of archetype `index`, in the order components were
+    // queried. Optional and excluded components that aren't present map to
+    // Archetype::no_column.
+    uint32_t const* columns(size_t index) const
+    {
+        return m_columns.data() + index * m_components.size();
+    }
+
+private:
+    std::vector<ComponentID> m_components {};
+    ComponentMask m_required {};
+    ComponentMask m_excluded {};
+    std::vector<Archetype*> m_archetypes {};
+    std::vector<uint32_t> m_columns {};
+};
+
+namespace detail {
+// The component a query term is on.
+template<typename Term>
+struct TermComponent {
+    using Type = std::remove_const_t<Term>;
+};
+
+template<typename T>
+struct TermComponent<Changed<T>> {
+    using Type = std::remove_const_t<T>;
+};
+
+template<typename T>
+struct TermComponent<Added<T>> {
+    using Type = std::remove_const_t<T>;
+};
+
+template<typename T>
+struct TermComponent<With<T>> {
+    using Type = std::remove_const_t<T>;
+};
+
+template<typename T>
+struct TermComponent<Without<T>> {
+    using Type = std::remove_const_t<T>;
+};
+
+template<typename T>
+struct TermComponent<Optional<T>> {
+    using Type = std::remove_const_t<T>;
+};
+
+// A plain component term is passed to the callback as a reference; `T const`
+// terms are read-only and don't bump change ticks.
+template<typename Term, StoragePolicy = storage_policy<typename TermComponent<Term>::Type>>
+struct QueryTerm {
+    using Component = std::remove_const_t<Term>;
+    static constexpr TermPresence presence = TermPresence::Required;
+
+    // Per-chunk state, resolved once per chunk instead of once per row.
+    struct Cursor {
+        Term* data { nullptr };
+        ChangeTick* changed_ticks { nullptr };
+
+        void begin_chunk(Archetype& archetype, size_t chunk, uint32_t column, SparseSet*)
+        {
+            if constexpr (is_tag_component<Component>) {
+                return;
+            }
+
+            data = static_cast<Term*>(archetype.chunk_column(chunk, column));
+
+            if constexpr (!std::is_const_v<Term>) {
+                changed_ticks = archetype.chunk_changed_ticks(chunk, column);
+            }
+        }
+
+        bool matches(size_t, QueryTicks) const
+        {
+            return true;
+        }
+
+        std::tuple<Term&> fetch(size_t row, QueryTicks ticks)
+        {
+            if constexpr (is_tag_component<Component>) {
+                return { tag_instance<Component>() };
+            } else {
+                if constexpr (!std::is_const_v<Term>) {
+                    changed_ticks[row] = ticks.current;
+                }
+
+                return { data[row] };
+            }
+        }
+    };
+
+    // Tags have no column to span, so they only restrict the matched archetypes.
+    static auto fetch_chunk(Archetype& archetype, size_t chunk, uint32_t column, QueryTicks ticks)
+    {
+        if constexpr (is_tag_component<Component>) {
+            return std::tuple<> {};
+        } else {
+            auto rows = archetype.chunk_row_count(chunk);
+
+            if constexpr (!std::is_const_v<Term>) {
+                std::fill_n(archetype.chunk_changed_ticks(chunk, column), rows, ticks.current);
+            }
+
+            return std::tuple<std::span<Term>> { std::span<Term>(static_cast<Term*>(archetype.chunk_column(chunk, column)), rows) };
+        }
+    }
+};
+
+template<typename T>
+struct QueryTerm<Changed<T>, StoragePolicy::Table> {
+    using Component = std::remove_const_t<T>;
+    static constexpr TermPresence presence = TermPresence::Required;
+
+    static_assert(!is_tag_component<Component>, "tags have no change ticks");
+
+    struct Cursor {
+        ChangeTick const* changed_ticks { nullptr };
+
+        void begin_chunk(Archetype& archetype, size_t chunk, uint32_t column, SparseSet*)
+        {
+            changed_ticks = archetype.chunk_changed_ticks(chunk, column);
+        }
+
+        bool matches(size_t row, QueryTicks ticks) const
+        {
+            return ticks.contains(changed_ticks[row]);
+        }
+
+        std::tuple<> fetch(size_t, QueryTicks)
+        {
+            return {};
+        }
+    };
+};
+
+template<typename T>
+struct QueryTerm<Added<T>, StoragePolicy::Table> {
+    using Component = std::remove_const_t<T>;
+    static constexpr TermPresence presence = TermPresence::Required;
+
+    static_assert(!is_tag_component<Component>, "tags have no change ticks");
+
+    struct Cursor {
+        ChangeTick const* added_ticks { nullptr };
+
+        void begin_chunk(Archetype& archetype, size_t chunk, uint32_t column, SparseSet*)
+        {
+            added_ticks = archetype.chunk_added_ticks(chunk, column);
+        }
+
+        bool matches(size_t row, QueryTicks ticks) const
+        {
+            return ticks.contains(added_ticks[row]);
+        }
+
+        std::tuple<> fetch(size_t, QueryTicks)
+        {
+            return {};
+        }
+    };
+};
+
+// With<T> and Without<T> only affect which archetypes match.
+template<typename T, TermPresence Presence>
+struct ArchetypeFilterTerm {
+    using Component = std::remove_const_t<T>;
+    static constexpr TermPresence presence = Presence;
+
+    struct Cursor {
+        void begin_chunk(Archetype&, size_t, uint32_t, SparseSet*)
+        {
+        }
+
+        bool matches(size_t, QueryTicks) const
+        {
+            return true;
+        }
+
+        std::tuple<> fetch(size_t, QueryTicks)
+        {
+            return {};
+        }
+    };
+
+    static std::tuple<> fetch_chunk(Archetype&, size_t, uint32_t, QueryTicks)
+    {
+        return {};
+    }
+};
+
+template<typename T>
+struct QueryTerm<With<T>, StoragePolicy::Table> : ArchetypeFilterTerm<T, TermPresence::Required> { };
+
+template<typename T>
+struct QueryTerm<Without<T>, StoragePolicy::Table> : ArchetypeFilterTerm<T, TermPresence::Excluded> { };
+
+template<typename T>
+struct QueryTerm<Optional<T>, StoragePolicy::Table> {
+    using Component = std::remove_const_t<T>;
+    static constexpr TermPresence presence = TermPresence::Optional;
+
+    struct Cursor {
+        T* data { nullptr };
+        ChangeTick* changed_ticks { nullptr };
+
+        void begin_chunk(Archetype& archetype, size_t chunk, uint32_t column, SparseSet*)
+        {
+            if (column == Archetype::no_column) {
+                data = nullptr;
+                return;
+            }
+
+            if constexpr (is_tag_component<Component>) {
+                data = &tag_instance<Component>();
+                return;
+            }
+
+            data = static_cast<T*>(archetype.chunk_column(chunk, column));
+
+            if constexpr (!std::is_const_v<T>) {
+                changed_ticks = archetype.chunk_changed_ticks(chunk, column);
+            }
+        }
+
+        bool matches(size_t, QueryTicks) const
+        {
+            return true;
+        }
+
+        std::tuple<T*> fetch(size_t row, QueryTicks ticks)
+        {
+            if (!data) {
+                return { nullptr };
+            }
+
+            if constexpr (is_tag_component<Component>) {
+                return { data };
+            } else {
+                if constexpr (!std::is_const_v<T>) {
+                    changed_ticks[row] = ticks.current;
+                }
+
+                return { data + row };
+            }
+        }
+    };
+};
+
+template<>
+struct QueryTerm<Entity, StoragePolicy::Table> {
+    using Component = Entity;
+    static constexpr TermPresence presence = TermPresence::Optional;
+
+    struct Cursor {
+        EntityID const* ids { nullptr };
+
+        void begin_chunk(Archetype& archetype, size_t chunk, uint32_t, SparseSet*)
+        {
+            ids = archetype.chunk_ids(chunk);
+        }
+
+        bool matches(size_t, QueryTicks) const
+        {
+            return true;
+        }
+
+        std::tuple<EntityID> fetch(size_t row, QueryTicks)
+        {
+            return { ids[row] };
+        }
+    };
+
+    static std::tuple<std::span<EntityID const>> fetch_chunk(Archetype& archetype, size_t chunk, uint32_t, QueryTicks)
+    {
+        return { std::span<EntityID const>(archetype.chunk_ids(chunk), archetype.chunk_row_count(chunk)) };
+    }
+};
+
+// Sparse components aren't part of any archetype, so terms on them are
+// resolved per row by looking the entity up in the component's SparseSet.
+// A null set (the component was never added) behaves like an empty one.
+struct SparseCursor {
+    SparseSet* set { nullptr };
+    EntityID const* ids { nullptr };
+    size_t dense { SparseSet::npos };
+
+    void begin_chunk(Archetype& archetype, size_t chunk, uint32_t, SparseSet* sparse_set)
+    {
+        set = sparse_set;
+        ids = archetype.chunk_ids(chunk);
+    }
+
+    // Looks up the row's entity and remembers its slot for fetch().
+    bool find(size_t row)
+    {
+        dense = set ? set->find(ids[row]) : SparseSet::npos;
+
+        return dense != SparseSet::npos;
+    }
+};
+
+template<typename Term>
+struct QueryTerm<Term, StoragePolicy::Sparse> {
+    using Component = std::remove_const_t<Term>;
+    static constexpr TermPresence presence = TermPresence::Optional;
+    static constexpr bool is_sparse_required = true;
+
+    struct Cursor : SparseCursor {
+        bool matches(size_t row, QueryTicks)
+        {
+            return find(row);
+        }
+
+        std::tuple<Term&> fetch(size_t, QueryTicks ticks)
+        {
+            if constexpr (is_tag_component<Component>) {
+                return { tag_instance<Component>() };
+            } else {
+                if constexpr (!std::is_const_v<Term>) {
+                    set->changed_tick_at(dense) = ticks.current;
+                }
+
+                return { *static_cast<Term*>(set->at(dense)) };
+            }
+        }
+    };
+};
+
+template<typename T>
+struct QueryTerm<Changed<T>, StoragePolicy::Sparse> {
+    using Component = std::remove_const_t<T>;
+    static constexpr TermPresence presence = TermPresence::Optional;
+    static constexpr bool is_sparse_required = true;
+
+    struct Cursor : SparseCursor {
+        bool matches(size_t row, QueryTicks ticks)
+        {
+            return find(row) && ticks.contains(set->changed_tick_at(dense));
+        }
+
+        std::tuple<> fetch(size_t, QueryTicks)
+        {
+            return {};
+        }
+    };
+};
+
+template<typename T>
+struct QueryTerm<Added<T>, StoragePolicy::Sparse> {
+    using Component = std::remove_const_t<T>;
+    static constexpr TermPresence presence = TermPresence::Optional;
+    static constexpr bool is_sparse_required = true;
+
+    struct Cursor : SparseCursor {
+        bool matches(size_t row, QueryTicks ticks)
+        {
+            return find(row) && ticks.contains(set->added_tick_at(dense));
+        }
+
+        std::tuple<> fetch(size_t, QueryTicks)
+        {
+            return {};
+        }
+    };
+};
+
+template<typename T, bool Present>
+struct SparseFilterTerm {
+    using Component = std::remove_const_t<T>;
+    static constexpr TermPresence presence = TermPresence::Optional;
+    static constexpr bool is_sparse_required = Present;
+
+    struct Cursor : SparseCursor {
+        bool matches(size_t row, QueryTicks)
+        {
+            return find(row) == Present;
+        }
+
+        std::tuple<> fetch(size_t, QueryTicks)
+        {
+            return {};
+        }
+    };
+};
+
+template<typename T>
+struct QueryTerm<With<T>, StoragePolicy::Sparse> : SparseFilterTerm<T, true> { };
+
+template<typename T>
+struct QueryTerm<Without<T>, StoragePolicy::Sparse> : SparseFilterTerm<T, false> { };
+
+template<typename T>
+struct QueryTerm<Optional<T>, StoragePolicy::Sparse> {
+    using Component = std::remove_const_t<T>;
+    static constexpr TermPresence presence = TermPresence::Optional;
+
+    struct Cursor : SparseCursor {
+        bool matches(size_t, QueryTicks)
+        {
+            return true;
+        }
+
+        std::tuple<T*> fetch(size_t row, QueryTicks ticks)
+        {
+            if (!find(row)) {
+                return { nullptr };
+            }
+
+            if constexpr (is_tag_component<Component>) {
+                return { &tag_instance<Component>() };
+            } else {
+                if constexpr (!std::is_const_v<T>) {
+                    set->changed_tick_at(dense) = ticks.current;
+                }
+
+                return { static_cast<T*>(set->at(dense)) };
+            }
+        }
+    };
+};
+
+// Terms on sparse components that only match entities in the component's
+// SparseSet, so a query can walk that set instead of every archetype.
+template<typename Term>
+constexpr bool is_required_sparse_term = requires { requires QueryTerm<Term>::is_sparse_required; };
+
+// Terms that can be fetched a whole chunk at a time. Per-row terms (filters
+// on change ticks, Optional, anything on a sparse component) can't.
+template<typename Term>
+concept ChunkQueryTerm = requires(Archetype& archetype, QueryTicks ticks) {
+    QueryTerm<Term>::fetch_chunk(archetype, size_t {}, uint32_t {}, ticks);
+};
+
+// Calls `f` with the fetched terms of every matching row in chunks
+// [first_chunk, last_chunk). `columns` holds one column index per term and
+// `sparse_sets` one SparseSet per term, null for table components.
+template<typename... Terms, typename F>
+void for_each_row(Archetype& archetype, uint32_t const* columns, SparseSet* const* sparse_sets, size_t first_chunk, size_t last_chunk, QueryTicks ticks, F& f)
+{
+    [&]<size_t... I>(std::index_sequence<I...>) {
+        std::tuple<typename QueryTerm<Terms>::Cursor...> cursors {};
+
+        for (auto chunk = first_chunk; chunk < last_chunk; chunk++) {
+            (std::get<I>(cursors).begin_chunk(archetype, chunk, columns[I], sparse_sets[I]), ...);
+
+            auto rows = archetype.chunk_row_count(chunk);
+
+            for (size_t i = 0; i < rows; i++) {
+                if (!(std::get<I>(cursors).matches(i, ticks) && ...)) {
+                    continue;
+                }
+
+                std::apply(f, std::tuple_cat(std::get<I>(cursors).fetch(i, ticks)...));
+            }
+        }
+    }(std::index_sequence_for<Terms...> {});
+}
+
+// Calls `f` with the fetched terms of every chunk in [first_chunk,
+// last_chunk): one span per component term, covering the chunk's rows of
+// that column and starting at an Archetype::column_alignment boundary.
+// Mutable terms mark every row of the chunk as changed.
+template<typename... Terms, typename F>
+void for_each_chunk(Archetype& archetype, uint32_t const* columns, size_t first_chunk, size_t last_chunk, QueryTicks ticks, F& f)
+{
+    static_assert((ChunkQueryTerm<Terms> && ...), "per-row terms can't be used in chunk queries");
+
+    [&]<size_t... I>(std::index_sequence<I...>) {
+        for (auto chunk = first_chunk; chunk < last_chunk; chunk++) {
+            std::apply(f, std::tuple_cat(QueryTerm<Terms>::fetch_chunk(archetype, chunk, columns[I], ticks)...));
+        }
+    }(std::index_sequence_for<Terms...> {});
+}
+}
+}
@@ -1,5 +1,528 @@
 #include <kata/ecs/registry.hpp>
 
 namespace kata {
+Archetype* Registry::find_archetype(std::span<ComponentID const> signature)
+{
+    auto it = m_archetype_by_signature.find(signature);
+    if (it == m_archetype_by_signature.end()) {
+        return nullptr;
+    }
 
+    return it->second;
+}
+
+Archetype& Registry::create_archetype(std::vector<ComponentInfo const*> components)
+{
+    auto archetype = std::make_unique<Archetype>(std::move(components));
+
+    assert(!find_archetype(archetype->signature()));
+
+    auto& result = *archetype;
+    m_archetype_by_signature.emplace(archetype->signature(), &result);
+    m_archetypes.push_back(std::move(archetype));
+
+    for (auto& [_, cache] : m_query_caches) {
+        cache.try_add(result);
+    }
+
+    return result;
+}
+
+EntityRange Registry::merge(Registry& staging)
+{
+    assert(&staging != this);
+
+    auto index_end = staging.m_id_allocator.index_end();
+    auto ids = m_id_allocator.allocate_range(index_end);
+
+    auto remap = [&](EntityID id) {
+        return id == null_entity ? null_entity : ids[entity_index(id)];
+    };
+
+    if (m_id_allocator.index_end() > m_entity_locations.size()) {
+        m_entity_locations.resize(m_id_allocator.index_end());
+    }
+
+    std::vector<bool> is_live(index_end);
+
+    for (auto& source : staging.m_archetypes) {
+        if (source->size() == 0) {
+            continue;
+        }
+
+        auto parent_column = source->column_index(component_id<Parent>());
+        auto children_column = source->column_index(component_id<Children>());
+
+        for (size_t chunk = 0; chunk < source->chunk_count(); chunk++) {
+            auto rows = source->chunk_row_count(chunk);
+            auto chunk_ids = source->chunk_ids(chunk);
+
+            for (size_t i = 0; i < rows; i++) {
+                is_live[entity_index(chunk_ids[i])] = true;
+                chunk_ids[i] = remap(chunk_ids[i]);
+            }
+
+            if (parent_column != Archetype::no_column) {
+                auto parents = static_cast<Parent*>(source->chunk_column(chunk, parent_column));
+
+                for (size_t i = 0; i < rows; i++) {
+                    parents[i].entity = remap(parents[i].entity);
+                }
+            }
+
+            if (children_column != Archetype::no_column) {
+                auto children = static_cast<Children*>(source->chunk_column(chunk, children_column));
+
+                for (size_t i = 0; i < rows; i++) {
+                    for (auto& child : children[i].entities) {
+                        child = remap(child);
+                    }
+                }
+            }
+        }
+
+        auto target = find_archetype(source->signature());
+        if (!target) {
+            target = &create_archetype({ source->components().begin(), source->components().end() });
+        }
+
+        for (auto row = target->splice(*source, change_tick()); row < target->size(); row++) {
+            m_entity_locations[entity_index(target->id_at(row))] = EntityLocation {
+                .archetype = target,
+                .row = row,
+            };
+        }
+    }
+
+    for (auto source : staging.m_sparse_set_list) {
+        if (source->size() == 0) {
+            continue;
+        }
+
+        auto& info = source->info();
+        auto& target = sparse_set(info);
+
+        for (size_t dense = 0; dense < source->size(); dense++) {
+            auto storage = target.emplace_uninitialized(remap(source->id_at(dense)), change_tick());
+
+            if (storage) {
+                relocate_component(info, storage, source->at(dense));
+            }
+        }
+
+        source->forget_all();
+    }
+
+    // Indices that were free in `staging` stay unused here too.
+    for (uint32_t index = 0; index < index_end; index++) {
+        if (!is_live[index]) {
+            m_id_allocator.free(ids[index]);
+        }
+    }
+
+    staging.m_id_allocator = IDAllocator {};
+    staging.m_entity_locations.clear();
+
+    return ids;
+}
+
+CompactionResult Registry::compact(size_t budget)
+{
+    CompactionResult result {};
+
+    for (; budget > 0 && m_compact_cursor < m_archetypes.size() + m_sparse_set_list.size(); budget--) {
+        if (m_compact_cursor >= m_archetypes.size()) {
+            result.bytes_reclaimed += m_sparse_set_list[m_compact_cursor - m_archetypes.size()]->shrink_to_fit();
+            m_compact_cursor++;
+            continue;
+        }
+
+        auto& archetype = *m_archetypes[m_compact_cursor];
+        result.bytes_reclaimed += archetype.shrink_to_fit();
+
+        if (archetype.size() > 0) {
+            m_compact_cursor++;
+            continue;
+        }
+
+        // Empty, so no entity location refers to it. The archetype taking
+        // its place in m_archetypes is visited next.
+        for (auto& other : m_archetypes) {
+            other->remove_edges_to(&archetype);
+        }
+
+        {
+            std::unique_lock lock(m_query_caches_mutex);
+
+            for (auto& [_, cache] : m_query_caches) {
+                cache.remove(archetype);
+            }
+        }
+
+        m_archetype_by_signature.erase(archetype.signature());
+
+        result.bytes_reclaimed += sizeof(Archetype);
+        result.archetypes_retired++;
+
+        m_archetypes[m_compact_cursor] = std::move(m_archetypes.back());
+        m_archetypes.pop_back();
+    }
+
+    if (m_compact_cursor >= m_archetypes.size() + m_sparse_set_list.size()) {
+        m_compact_cursor = 0;
+        result.is_complete = true;
+    }
+
+    return result;
+}
+
+Archetype& Registry::archetype_with(Archetype& source, ComponentInfo const& component)
+{
+    assert(component.storage == StoragePolicy::Table);
+
+    auto& edge = source.edge(component.id);
+    if (edge.add) {
+        return *edge.add;
+    }
+
+    std::vector<ComponentInfo const*> components(source.components().begin(), source.components().end());
+    components.push_back(&component);
+
+    ArchetypeSignature signature(source.signature());
+    signature.insert(std::upper_bound(signature.begin(), signature.end(), component.id), component.id);
+
+    auto target = find_archetype(signature);
+    if (!target) {
+        target = &create_archetype(std::move(components));
+    }
+
+    edge.add = target;
+    target->edge(component.id).remove = &source;
+
+    return *target;
+}
+
+Archetype& Registry::archetype_without(Archetype& source, ComponentID component)
+{
+    auto& edge = source.edge(component);
+    if (edge.remove) {
+        return *edge.remove;
+    }
+
+    std::vector<ComponentInfo const*> components;
+    components.reserve(source.components().size());
+
+    for (auto info : source.components()) {
+        if (info->id != component) {
+            components.push_back(info);
+        }
+    }
+
+    ArchetypeSignature signature(source.signature());
+    std::erase(signature, component);
+
+    auto target = find_archetype(signature);
+    if (!target) {
+        target = &create_archetype(std::move(components));
+    }
+
+    edge.remove = target;
+    target->edge(component).add = &source;
+
+    return *target;
+}
+
+SparseSet& Registry::sparse_set(ComponentInfo const& info)
+{
+    assert(info.storage == StoragePolicy::Sparse);
+
+    if (info.id >= m_sparse_sets.size()) {
+        m_sparse_sets.resize(info.id + 1);
+    }
+
+    auto& set = m_sparse_sets[info.id];
+    if (!set) {
+        set = std::make_unique<SparseSet>(info);
+        m_sparse_set_list.push_back(set.get());
+    }
+
+    return *set;
+}
+
+// Fills `count` consecutive slots of `size` bytes at `dst` with the value at
+// `src`, doubling the copied block each step.
+static void fill_copies(std::byte* dst, void const* src, size_t size, size_t count)
+{
+    if (count == 0) {
+        return;
+    }
+
+    std::memcpy(dst, src, size);
+
+    for (size_t filled = 1; filled < count;) {
+        auto n = std::min(filled, count - filled);
+
+        std::memcpy(dst + filled * size, dst, n * size);
+        filled += n;
+    }
+}
+
+EntityRange Registry::instantiate(EntityID prefab, size_t count)
+{
+    auto& source = *location_of(prefab).archetype;
+    auto row = location_of(prefab).row;
+
+    auto* target = &source;
+    for (auto component : { component_id<Prefab>(), component_id<Children>() }) {
+        if (target->has_component(component)) {
+            target = &archetype_without(*target, component);
+        }
+    }
+
+    auto ids = m_id_allocator.allocate_range(count);
+    auto first_row = target->push_rows_uninitialized(ids, change_tick());
+
+    for (uint32_t column = 0; column < target->column_count(); column++) {
+        auto& info = target->column_info(column);
+        auto value = source.at(source.column_index(info.id), row);
+
+        target->for_each_chunk_segment(first_row, count, [&](size_t chunk, size_t index, size_t rows, size_t) {
+            auto destination = static_cast<std::byte*>(target->chunk_column(chunk, column)) + index * info.size;
+
+            if (info.is_trivially_copyable) {
+                fill_copies(destination, value, info.size, rows);
+                return;
+            }
+
+            for (size_t i = 0; i < rows; i++) {
+                copy_component(info, destination + i * info.size, value);
+            }
+        });
+    }
+
+    set_batch_locations(ids, *target, first_row);
+
+    for (auto set : m_sparse_set_list) {
+        auto dense = set->find(prefab);
+        if (dense == SparseSet::npos) {
+            continue;
+        }
+
+        for (auto id : ids) {
+            auto storage = set->emplace_uninitialized(id, change_tick());
+
+            // emplace_uninitialized() may reallocate, so look the value up again.
+            if (storage) {
+                copy_component(set->info(), storage, set->at(dense));
+            }
+        }
+    }
+
+    if (auto parent = try_get<Parent const>(prefab)) {
+        auto& siblings = get<Children>(parent->entity).entities;
+        siblings.insert(siblings.end(), ids.begin(), ids.end());
+    }
+
+    return ids;
+}
+
+void Registry::despawn(EntityID id)
+{
+    remove_parent(id);
+
+    if (auto children = try_get<Children>(id)) {
+        auto entities = std::move(children->entities);
+
+        for (auto child : entities) {
+            remove_component<Parent>(child);
+            update_subtree_depths(child, 0);
+        }
+    }
+
+    despawn_unlinked(id);
+}
+
+void Registry::despawn_recursive(EntityID id)
+{
+    remove_parent(id);
+
+    std::vector<EntityID> subtree { id };
+
+    for (size_t i = 0; i < subtree.size(); i++) {
+        if (auto children = try_get<Children const>(subtree[i])) {
+            subtree.insert(subtree.end(), children->entities.begin(), children->entities.end());
+        }
+    }
+
+    // The whole subtree goes away, so there are no links left to fix up.
+    for (auto entity : subtree) {
+        despawn_unlinked(entity);
+    }
+}
+
+void Registry::set_parent(EntityID child, EntityID parent)
+{
+    assert(is_alive(child) && is_alive(parent));
+    assert(!is_ancestor_or_self(child, parent) && "set_parent would create a cycle");
+
+    auto grandparent = try_get<Parent const>(parent);
+    auto depth = grandparent ? grandparent->depth + 1 : 1;
+
+    remove_parent(child);
+    add_component(child, Parent { .entity = parent, .depth = depth });
+
+    if (auto children = try_get<Children>(parent)) {
+        children->entities.push_back(child);
+    } else {
+        add_component(parent, Children { .entities = { child } });
+    }
+
+    update_subtree_depths(child, depth);
+}
+
+void Registry::remove_parent(EntityID child)
+{
+    auto parent = try_get<Parent const>(child);
+    if (!parent) {
+        return;
+    }
+
+    auto parent_id = parent->entity;
+    auto& siblings = get<Children>(parent_id).entities;
+
+    std::erase(siblings, child);
+
+    // Leaves don't keep an empty Children around, so they stay in leaner archetypes.
+    if (siblings.empty()) {
+        remove_component<Children>(parent_id);
+    }
+
+    remove_component<Parent>(child);
+    update_subtree_depths(child, 0);
+}
+
+bool Registry::is_ancestor_or_self(EntityID ancestor, EntityID id)
+{
+    while (id != ancestor) {
+        auto parent = try_get<Parent const>(id);
+        if (!parent) {
+            return false;
+        }
+
+        id = parent->entity;
+    }
+
+    return true;
+}
+
+void Registry::update_subtree_depths(EntityID id, uint32_t depth)
+{
+    std::vector<std::pair<EntityID, uint32_t>> stack { { id, depth } };
+
+    while (!stack.empty()) {
+        auto [entity, entity_depth] = stack.back();
+        stack.pop_back();
+
+        auto children = try_get<Children const>(entity);
+        if (!children) {
+            continue;
+        }
+
+        for (auto child : children->entities) {
+            get<Parent>(child).depth = entity_depth + 1;
+            stack.push_back({ child, entity_depth + 1 });
+        }
+    }
+}
+
+void Registry::despawn_unlinked(EntityID id)
+{
+    auto& location = location_of(id);
+    auto& archetype = *location.archetype;
+    auto row = location.row;
+
+    archetype.remove_row(row);
+    location = EntityLocation {};
+
+    for (auto set : m_sparse_set_list) {
+        set->remove(id);
+    }
+
+    if (row < archetype.size()) {
+        location_of(archetype.id_at(row)).row = row;
+    }
+
+    m_id_allocator.free(id);
+    m_despawn_count++;
+}
+
+size_t Registry::move_entity(EntityID id, Archetype& target)
+{
+    auto& location = location_of(id);
+    auto& source = *location.archetype;
+    auto row = location.row;
+
+    location = EntityLocation {
+        .archetype = &target,
+        .row = source.move_row_to(row, target, change_tick()),
+    };
+
+    if (row < source.size()) {
+        location_of(source.id_at(row)).row = row;
+    }
+
+    return location.row;
+}
+
+void Registry::set_location(EntityID id, EntityLocation location)
+{
+    auto index = entity_index(id);
+    if (index >= m_entity_locations.size()) {
+        m_entity_locations.resize(std::max<size_t>(index + 1, m_entity_locations.size() * 2));
+    }
+
+    m_entity_locations[index] = location;
+}
+
+void Registry::set_batch_locations(EntityRange const& ids, Archetype& archetype, size_t first_row)
+{
+    if (m_id_allocator.index_end() > m_entity_locations.size()) {
+        m_entity_locations.resize(m_id_allocator.index_end());
+    }
+
+    for (size_t i = 0; i < ids.size(); i++) {
+        m_entity_locations[entity_index(ids[i])] = EntityLocation {
+            .archetype = &archetype,
+            .row = first_row + i,
+        };
+    }
+}
+
+QueryCache& Registry::query_cache(std::span<ComponentID const> key)
+{
+    {
+        std::shared_lock lock(m_query_caches_mutex);
+
+        auto it = m_query_caches.find(key);
+        if (it != m_query_caches.end()) {
+            return it->second;
+        }
+    }
+
+    std::unique_lock lock(m_query_caches_mutex);
+
+    // Another system may have built the cache while the lock was released.
+    if (auto it = m_query_caches.find(key); it != m_query_caches.end()) {
+        return it->second;
+    }
+
+    auto [inserted, _] = m_query_caches.emplace(ArchetypeSignature(key.begin(), key.end()), QueryCache(key));
+    auto& cache = inserted->second;
+
+    for (auto& archetype : m_archetypes) {
+        cache.try_add(*archetype);
+    }
+
+    return cache;
+}
 }
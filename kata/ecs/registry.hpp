@@ -1,163 +1,552 @@
 #pragma once
 
-#include <any>
+#include <algorithm>
 #include <array>
 #include <assert.h>
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <kata/core/error.hpp>
+#include <kata/core/job_system.hpp>
+#include <kata/ecs/archetype.hpp>
+#include <kata/ecs/component.hpp>
+#include <kata/ecs/event.hpp>
+#include <kata/ecs/hierarchy.hpp>
 #include <kata/ecs/id_allocator.hpp>
+#include <kata/ecs/prefab.hpp>
+#include <kata/ecs/query.hpp>
+#include <kata/ecs/resource.hpp>
+#include <kata/ecs/sparse_set.hpp>
+#include <memory>
+#include <shared_mutex>
 #include <span>
-#include <typeindex>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 namespace kata {
-class Archetype {
+struct EntityLocation {
+    Archetype* archetype { nullptr };
+    size_t row {};
+};
+
+struct CompactionResult {
+    size_t bytes_reclaimed {};
+    size_t archetypes_retired {};
+    // False if the budget ran out first; the next compact() call continues
+    // where this one stopped.
+    bool is_complete {};
+};
+
+class Registry {
+    friend class CommandBuffer;
+
 public:
-    Archetype(Archetype const&) = delete;
-    Archetype& operator=(Archetype const&) = delete;
+    // par_query(), event channels and the systems run on the registry use
+    // `jobs`.
+    explicit Registry(JobSystem& jobs = JobSystem::shared())
+        : m_jobs(&jobs)
+    {
+    }
 
-    Archetype(Archetype&&) = default;
-    Archetype& operator=(Archetype&&) = default;
+    JobSystem& jobs()
+    {
+        return *m_jobs;
+    }
 
     template<typename... Components>
-    static Archetype create()
+    EntityID spawn_with(Components... components)
     {
-        Archetype archetype {};
+        EntityID id = m_id_allocator.allocate();
 
-        archetype.m_column_types = {
-            std::type_index(typeid(Components))...
-        };
+        auto& archetype = archetype_for<Components...>();
+        auto row = archetype.push_row_uninitialized(id, change_tick());
+
+        ([&] {
+            if constexpr (is_sparse_component<Components>) {
+                insert_sparse(id, std::move(components));
+            } else if constexpr (!is_tag_component<Components>) {
+                new (archetype.at(archetype.column_index(component_id<Components>()), row)) Components(std::move(components));
+            }
+        }(),
+            ...);
+
+        set_location(id, EntityLocation {
+            .archetype = &archetype,
+            .row = row,
+        });
+
+        return id;
+    }
+
+    // Spawns `count` entities in one go: the archetype is resolved once, all
+    // chunks are allocated up front and the IDs come from a single range.
+    // `generator(i)` returns a std::tuple<Components...> for the i-th entity.
+    template<typename... Components, typename F>
+    EntityRange spawn_batch(size_t count, F generator)
+    {
+        auto& archetype = archetype_for<Components...>();
+        auto ids = m_id_allocator.allocate_range(count);
+        auto first_row = archetype.push_rows_uninitialized(ids, change_tick());
+
+        uint32_t columns[] { archetype.column_index(component_id<Components>())... };
+
+        archetype.for_each_chunk_segment(first_row, count, [&](size_t chunk, size_t index, size_t rows, size_t done) {
+            [&]<size_t... I>(std::index_sequence<I...>) {
+                std::tuple<Components*...> data {
+                    column_data<Components>(archetype, chunk, columns[I], index)...
+                };
+
+                for (size_t i = 0; i < rows; i++) {
+                    auto values = generator(done + i);
+
+                    ([&] {
+                        if constexpr (is_sparse_component<Components>) {
+                            insert_sparse(ids[done + i], std::move(std::get<I>(values)));
+                        } else if constexpr (!is_tag_component<Components>) {
+                            new (std::get<I>(data) + i) Components(std::move(std::get<I>(values)));
+                        }
+                    }(),
+                        ...);
+                }
+            }(std::index_sequence_for<Components...> {});
+        });
+
+        set_batch_locations(ids, archetype, first_row);
 
-        (archetype.m_columns.push_back(std::move(std::vector<Components>{})), ...);
+        return ids;
+    }
+
+    // Spawns one entity per element, copying component values out of
+    // equally sized columns. Trivially copyable columns are copied with memcpy.
+    template<typename... Components>
+    EntityRange spawn_batch(std::span<Components const>... columns)
+    {
+        std::array<size_t, sizeof...(Components)> sizes { columns.size()... };
+        auto count = sizes[0];
+
+        assert(std::all_of(sizes.begin(), sizes.end(), [&](auto size) { return size == count; }));
+
+        auto& archetype = archetype_for<Components...>();
+        auto ids = m_id_allocator.allocate_range(count);
+        auto first_row = archetype.push_rows_uninitialized(ids, change_tick());
+
+        archetype.for_each_chunk_segment(first_row, count, [&](size_t chunk, size_t index, size_t rows, size_t done) {
+            (copy_into_column(archetype, chunk, index, columns.subspan(done, rows)), ...);
+        });
+
+        ([&] {
+            if constexpr (is_sparse_component<Components>) {
+                for (size_t i = 0; i < count; i++) {
+                    insert_sparse(ids[i], columns[i]);
+                }
+            }
+        }(),
+            ...);
+
+        set_batch_locations(ids, archetype, first_row);
+
+        return ids;
+    }
+
+    // Spawns `count` copies of `prefab`, which is usually tagged with Prefab.
+    // The copies share the prefab's archetype minus Prefab, so its row is
+    // cloned column by column: trivially copyable columns are filled with
+    // memcpy, the rest are copy constructed. Copies of an entity with a
+    // Parent become its siblings; Children aren't copied.
+    EntityRange instantiate(EntityID prefab, size_t count);
+
+    // Destroys the entity and all of its components. Its children become
+    // roots. Like every call that modifies an entity, panics if `id` is stale.
+    void despawn(EntityID id);
 
-        return archetype;
+    // Despawns the entity and all of its descendants.
+    void despawn_recursive(EntityID id);
+
+    // Makes `child` a child of `parent`, detaching it from its current parent
+    // first. `parent` must not be `child` or one of its descendants.
+    void set_parent(EntityID child, EntityID parent);
+
+    // Detaches `child` from its parent, making it a root. Does nothing for
+    // roots.
+    void remove_parent(EntityID child);
+
+    bool is_alive(EntityID id) const
+    {
+        return find_location(id) != nullptr;
+    }
+
+    // Number of entities despawned so far. Lets caches keyed by entity tell
+    // cheaply whether any of their entries may have died.
+    uint64_t despawn_count() const
+    {
+        return m_despawn_count;
     }
 
+    // Mutable access (non-const T) marks the component as changed. Panics if
+    // the entity is dead or has no T.
     template<typename T>
-    std::vector<T>& column_for_type()
+    T& get(EntityID id)
     {
-        auto it = std::find(m_column_types.begin(), m_column_types.end(), std::type_index(typeid(T)));
+        auto component = try_get<T>(id);
 
-        assert(it != m_column_types.end());
+        if (!component) [[unlikely]] {
+            check_alive(id);
+            panic(Error::with_message("Entity " + std::to_string(entity_index(id)) + " has no `" + std::string(component_info<std::remove_const_t<T>>().name) + "`"));
+        }
 
-        auto column_vector_index = it - m_column_types.begin();
-        auto& column = m_columns[column_vector_index];
-        auto& column_vector = std::any_cast<std::vector<T>&>(column);
+        return *component;
+    }
 
-        return column_vector;
+    // Returns nullptr if the entity is dead or has no T.
+    template<typename T>
+    T* try_get(EntityID id)
+    {
+        auto location = find_location(id);
+        if (!location) {
+            return nullptr;
+        }
+
+        if constexpr (is_sparse_component<std::remove_const_t<T>>) {
+            return try_get_sparse<T>(id);
+        }
+
+        auto index = location->archetype->column_index(component_id<T>());
+        if (index == Archetype::no_column) {
+            return nullptr;
+        }
+
+        if constexpr (is_tag_component<std::remove_const_t<T>>) {
+            return &detail::tag_instance<std::remove_const_t<T>>();
+        } else {
+            if constexpr (!std::is_const_v<T>) {
+                location->archetype->changed_tick_at(index, location->row) = change_tick();
+            }
+
+            return static_cast<T*>(location->archetype->at(index, location->row));
+        }
     }
 
-    bool matches_exactly(std::span<std::type_index> types) const
+    // Adds `component` to the entity, moving it to the neighbouring archetype.
+    // If the entity already has a T, it is overwritten in place.
+    template<typename T>
+    void add_component(EntityID id, T component)
     {
-        if (types.size() != m_column_types.size()) {
-            return false;
+        if constexpr (is_sparse_component<T>) {
+            add_sparse(id, std::move(component));
+            return;
         }
 
-        for (auto type : types) {
-            auto it = std::find(m_column_types.begin(), m_column_types.end(), type);
+        auto& location = location_of(id);
+        auto& source = *location.archetype;
+        auto& info = component_info<T>();
 
-            if (it == m_column_types.end()) {
-                return false;
+        if (auto index = source.column_index(info.id); index != Archetype::no_column) {
+            if constexpr (!is_tag_component<T>) {
+                *static_cast<T*>(source.at(index, location.row)) = std::move(component);
+                source.changed_tick_at(index, location.row) = change_tick();
             }
+
+            return;
         }
 
-        return true;
+        auto& target = archetype_with(source, info);
+        auto row = move_entity(id, target);
+
+        if constexpr (!is_tag_component<T>) {
+            new (target.at(target.column_index(info.id), row)) T(std::move(component));
+        }
     }
 
-    bool contains_components(std::span<std::type_index> types) const {
-        for (auto type : types) {
-            auto it = std::find(m_column_types.begin(), m_column_types.end(), type);
+    // Removes T from the entity, moving it to the neighbouring archetype.
+    // Does nothing if the entity has no T.
+    template<typename T>
+    void remove_component(EntityID id)
+    {
+        if constexpr (is_sparse_component<T>) {
+            check_alive(id);
 
-            if (it == m_column_types.end()) {
-                return false;
+            if (auto set = find_sparse_set(component_id<T>())) {
+                set->remove(id);
             }
+
+            return;
+        }
+
+        auto& source = *location_of(id).archetype;
+        auto component = component_id<T>();
+
+        if (!source.has_component(component)) {
+            return;
         }
 
-        return true;
+        move_entity(id, archetype_without(source, component));
     }
 
+    // Returns the archetype holding exactly the table components among
+    // `Components`, creating it if needed. Sparse components are skipped.
     template<typename... Components>
-    void write_column(EntityID id, Components... components)
+    Archetype& archetype_for()
     {
-        std::tuple<std::vector<Components>&...> columns {
-            column_for_type<Components>()...
-        };
+        constexpr size_t table_count = (size_t(!is_sparse_component<Components>) + ... + 0);
 
-        (std::get<std::vector<Components>&>(columns).push_back(std::move(components)), ...);
+        std::array<ComponentInfo const*, table_count> infos {};
+        size_t next = 0;
 
-        m_id_column.push_back(id);
+        ([&] {
+            if constexpr (!is_sparse_component<Components>) {
+                infos[next++] = &component_info<Components>();
+            }
+        }(),
+            ...);
+
+        std::array<ComponentID, table_count> signature {};
+        std::transform(infos.begin(), infos.end(), signature.begin(), [](auto info) { return info->id; });
+        std::sort(signature.begin(), signature.end());
+
+        if (auto archetype = find_archetype(signature)) {
+            return *archetype;
+        }
 
-        m_size++;
+        return create_archetype({ infos.begin(), infos.end() });
     }
 
-    size_t size() const
+    Archetype* find_archetype(std::span<ComponentID const> signature);
+    Archetype& create_archetype(std::vector<ComponentInfo const*> components);
+
+    // Archetype graph traversal. Results are cached as edges on `source`, so
+    // only the first transition between two archetypes hashes a signature.
+    Archetype& archetype_with(Archetype& source, ComponentInfo const& component);
+    Archetype& archetype_without(Archetype& source, ComponentID component);
+
+    // Calls `f` for every entity matching all `Terms`. Plain component terms
+    // are passed as references (`T const` for read-only access); filter terms
+    // such as Changed<T> only restrict which entities are visited, and match
+    // rows touched since the last advance_tick().
+    template<typename... Terms, typename F>
+    void query(F f)
     {
-        return m_size;
+        query<Terms...>(query_ticks(), f);
     }
 
-private:
-    Archetype() = default;
+    // Like query(), but filters match rows touched within `ticks`, usually a
+    // consumer's window from track_changes().
+    template<typename... Terms, typename F>
+    void query(QueryTicks ticks, F f)
+    {
+        auto& cache = query_cache<Terms...>();
+        auto sparse_sets = sparse_sets_for<Terms...>();
 
-    std::vector<std::type_index> m_column_types {};
-    std::vector<EntityID> m_id_column {};
-    std::vector<std::any> m_columns {};
-    size_t m_size {};
-};
+        if constexpr ((detail::is_required_sparse_term<Terms> || ...)) {
+            auto set = smallest_required_sparse_set<Terms...>(sparse_sets);
+            if (!set) {
+                return;
+            }
 
-class Registry {
-public:
-    Registry() = default;
+            // Walking the set costs a location lookup per entity, so it only
+            // pays off if the set is clearly smaller than the archetypes.
+            if (set->size() * 2 < cache.row_count()) {
+                for_each_sparse_row<Terms...>(cache, *set, sparse_sets.data(), 0, set->size(), ticks, f);
+                return;
+            }
+        }
 
-    template<typename... Components>
-    EntityID spawn_with(Components... components)
+        for (size_t a = 0; a < cache.archetype_count(); a++) {
+            auto& archetype = cache.archetype(a);
+
+            detail::for_each_row<Terms...>(archetype, cache.columns(a), sparse_sets.data(), 0, archetype.chunk_count(), ticks, f);
+        }
+    }
+
+    // Like query(), but calls `f` once per chunk with a std::span per term
+    // (e.g. std::span<Position>, std::span<Velocity const>) instead of once per
+    // row, so the loop body can be vectorized. Spans start on
+    // Archetype::column_alignment boundaries. Filters are not supported.
+    template<typename... Terms, typename F>
+    void query_chunks(F f)
     {
-        std::array<std::type_index, sizeof...(Components)> type_indexes {
-            std::type_index(typeid(Components))...
-        };
+        auto& cache = query_cache<Terms...>();
 
-        EntityID id = m_id_allocator.allocate();
+        for (size_t a = 0; a < cache.archetype_count(); a++) {
+            auto& archetype = cache.archetype(a);
 
-        Archetype* exact_archetype { nullptr };
+            detail::for_each_chunk<Terms...>(archetype, cache.columns(a), 0, archetype.chunk_count(), query_ticks(), f);
+        }
+    }
 
-        for (auto& archetype : m_archetypes) {
-            if (archetype.matches_exactly(type_indexes)) {
-                exact_archetype = &archetype;
+    static constexpr size_t default_grain_size = 4096;
+
+    // Like query(), but splits the matching archetypes into ranges of whole
+    // chunks holding roughly `grain_size` rows and runs them on the
+    // registry's job system. `f` is called concurrently and must not make
+    // structural changes.
+    template<typename... Terms, typename F>
+    void par_query(F f, size_t grain_size = default_grain_size)
+    {
+        par_query<Terms...>(query_ticks(), f, grain_size);
+    }
+
+    template<typename... Terms, typename F>
+    void par_query(QueryTicks ticks, F f, size_t grain_size = default_grain_size)
+    {
+        assert(grain_size > 0);
+
+        auto& cache = query_cache<Terms...>();
+        auto sparse_sets = sparse_sets_for<Terms...>();
+
+        if constexpr ((detail::is_required_sparse_term<Terms> || ...)) {
+            auto set = smallest_required_sparse_set<Terms...>(sparse_sets);
+            if (!set) {
+                return;
+            }
+
+            if (set->size() * 2 < cache.row_count()) {
+                m_jobs->parallel_for(set->size(), grain_size, [&](size_t first, size_t last) {
+                    for_each_sparse_row<Terms...>(cache, *set, sparse_sets.data(), first, last, ticks, f);
+                });
+                return;
             }
         }
 
-        if (!exact_archetype) {
-            auto archetype = Archetype::create<Components...>();
-            m_archetypes.push_back(std::move(archetype));
-            exact_archetype = &m_archetypes.back();
+        struct ChunkRange {
+            size_t archetype;
+            size_t begin;
+            size_t end;
+        };
+
+        std::vector<ChunkRange> ranges;
+
+        for (size_t a = 0; a < cache.archetype_count(); a++) {
+            auto& archetype = cache.archetype(a);
+            auto chunk_count = archetype.chunk_count();
+            auto chunks_per_range = std::max<size_t>(grain_size / archetype.chunk_capacity(), 1);
+
+            for (size_t begin = 0; begin < chunk_count; begin += chunks_per_range) {
+                ranges.push_back(ChunkRange {
+                    .archetype = a,
+                    .begin = begin,
+                    .end = std::min(begin + chunks_per_range, chunk_count),
+                });
+            }
         }
 
-        assert(exact_archetype != nullptr);
+        m_jobs->parallel_for(ranges.size(), 1, [&](size_t first, size_t last) {
+            for (auto index = first; index < last; index++) {
+                auto const& range = ranges[index];
 
-        exact_archetype->write_column(id, std::forward<Components>(components)...);
+                detail::for_each_row<Terms...>(cache.archetype(range.archetype), cache.columns(range.archetype), sparse_sets.data(), range.begin, range.end, ticks, f);
+            }
+        });
+    }
 
-        return id;
+    // Returns the cached archetype match list for a query over `components`.
+    // Safe to call from concurrently running systems.
+    // `key` is a query key as described for QueryCache.
+    QueryCache& query_cache(std::span<ComponentID const> key);
+
+    template<typename... Terms>
+    QueryCache& query_cache()
+    {
+        std::array<ComponentID, 2 * sizeof...(Terms)> key {
+            component_id<typename detail::QueryTerm<Terms>::Component>()...,
+            ComponentID(detail::QueryTerm<Terms>::presence)...
+        };
+
+        return query_cache(key);
     }
 
-    template<typename... Components, typename F>
-    void query(F f)
+    ChangeTick change_tick() const
     {
-        std::array<std::type_index, sizeof...(Components)> type_indexes {
-            std::type_index(typeid(Components))...
+        return m_change_tick.load(std::memory_order_relaxed);
+    }
+
+    // Starts the next change detection window of `tracker` and returns it
+    // for use with query() and par_query(): filters match rows touched since
+    // the tracker's previous window, and anything written from now on falls
+    // into the next one. Safe to call from concurrently running systems.
+    QueryTicks track_changes(ChangeTracker& tracker)
+    {
+        auto current = m_change_tick.fetch_add(1, std::memory_order_relaxed);
+        auto last = std::exchange(tracker.m_last_tick, current);
+
+        return QueryTicks {
+            .current = current,
+            .last = last,
         };
+    }
 
-        for (auto& archetype : m_archetypes) {
-            if (!archetype.contains_components(type_indexes)) {
-                continue;
+    // Moves every entity of `staging` into this registry, leaving `staging`
+    // empty and reusable. Meant for worlds built off-thread: archetype chunks
+    // are taken over as they are, so no component is constructed or copied
+    // again (see Archetype::splice()), and new IDs come from one
+    // allocate_range() call.
+    // The entity `id` of `staging` becomes `result[entity_index(id)]`.
+    // Parent and Children links are remapped; other components holding
+    // EntityIDs refer to `staging` IDs and have to be fixed up by the caller.
+    // Merged entities are marked as added. Makes structural changes.
+    EntityRange merge(Registry& staging);
+
+    // Releases memory kept at peak capacity: spare chunks of archetypes and
+    // unused sparse set storage. Empty archetypes are destroyed, so queries
+    // stop visiting them; they're recreated on demand. Visits at most
+    // `budget` archetypes and sparse sets per call, so a large cleanup can be
+    // spread over several frames. Makes structural changes.
+    CompactionResult compact(size_t budget = SIZE_MAX);
+
+    // Writes all entities and components to a binary snapshot at `path`.
+    // Trivially copyable components are stored as raw column bytes; other
+    // components must be SnapshotSerializable.
+    Error save_snapshot(std::filesystem::path const& path);
+
+    // Loads a snapshot written by save_snapshot() into this registry, which
+    // must not have spawned any entities yet. Entity IDs are preserved and
+    // all components are marked as added. Every component type in the
+    // snapshot has to be registered (e.g. through component_id<T>()) before
+    // loading, since they are matched by name. On error the registry may be
+    // left partially loaded.
+    Error load_snapshot(std::filesystem::path const& path);
+
+    // The registry's channel for events of type T, created on first use.
+    // Safe to call from concurrently running systems.
+    template<typename T>
+    Events<T>& events()
+    {
+        auto id = resource_id<Events<T>>();
+
+        {
+            std::shared_lock lock(m_event_channels_mutex);
+
+            if (id < m_event_channels.size() && m_event_channels[id]) {
+                return static_cast<Events<T>&>(*m_event_channels[id]);
             }
+        }
 
-            std::tuple<std::vector<Components>&...> columns {
-                archetype.column_for_type<Components>()...
-            };
+        std::unique_lock lock(m_event_channels_mutex);
 
-            for (size_t i = 0; i < archetype.size(); i++) {
-                std::tuple<Components&...> components {
-                    std::get<std::vector<Components>&>(columns)[i]...
-                };
+        if (id >= m_event_channels.size()) {
+            m_event_channels.resize(id + 1);
+        }
+
+        if (!m_event_channels[id]) {
+            m_event_channels[id] = std::make_unique<Events<T>>(*m_jobs);
+        }
 
-                f(std::get<Components&>(components)...);
+        return static_cast<Events<T>&>(*m_event_channels[id]);
+    }
+
+    // Starts a new change detection period, typically once per frame.
+    // Changed<T>/Added<T> in queries without a tracker match rows touched
+    // since the previous call. Event channels move on to the next frame as
+    // well.
+    void advance_tick()
+    {
+        m_last_change_tick = m_change_tick.fetch_add(1, std::memory_order_relaxed);
+
+        for (auto& channel : m_event_channels) {
+            if (channel) {
+                channel->update();
             }
         }
     }
@@ -165,8 +554,260 @@ public:
 private:
     void allocate_id();
 
-    std::vector<Archetype> m_archetypes;
+    QueryTicks query_ticks() const
+    {
+        return QueryTicks {
+            .current = change_tick(),
+            .last = m_last_change_tick,
+        };
+    }
+
+    EntityLocation const* find_location(EntityID id) const
+    {
+        if (!m_id_allocator.is_alive(id)) {
+            return nullptr;
+        }
+
+        return &m_entity_locations[entity_index(id)];
+    }
+
+    // A stale handle would otherwise silently hit whichever entity reused
+    // its index, so mutating paths check the generation in release builds
+    // too.
+    void check_alive(EntityID id) const
+    {
+        if (!m_id_allocator.is_alive(id)) [[unlikely]] {
+            panic(Error::with_message("Entity " + std::to_string(entity_index(id)) + " generation " + std::to_string(entity_generation(id)) + " is not alive"));
+        }
+    }
+
+    EntityLocation& location_of(EntityID id)
+    {
+        check_alive(id);
+
+        return m_entity_locations[entity_index(id)];
+    }
+
+    void set_location(EntityID id, EntityLocation location);
+    void set_batch_locations(EntityRange const& ids, Archetype& archetype, size_t first_row);
+
+    SparseSet* find_sparse_set(ComponentID component)
+    {
+        if (component >= m_sparse_sets.size()) {
+            return nullptr;
+        }
+
+        return m_sparse_sets[component].get();
+    }
+
+    SparseSet& sparse_set(ComponentInfo const& info);
+
+    // One entry per query term: the SparseSet of terms on sparse components,
+    // nullptr for the rest.
+    template<typename... Terms>
+    std::array<SparseSet*, sizeof...(Terms)> sparse_sets_for()
+    {
+        return { [&]() -> SparseSet* {
+            using Component = typename detail::QueryTerm<Terms>::Component;
+
+            if constexpr (is_sparse_component<Component>) {
+                return find_sparse_set(component_id<Component>());
+            } else {
+                return nullptr;
+            }
+        }()... };
+    }
+
+    // The smallest SparseSet among the required sparse terms, or nullptr if
+    // one of them doesn't exist yet, in which case nothing can match.
+    template<typename... Terms>
+    static SparseSet* smallest_required_sparse_set(std::array<SparseSet*, sizeof...(Terms)> const& sparse_sets)
+    {
+        std::array<bool, sizeof...(Terms)> is_required { detail::is_required_sparse_term<Terms>... };
+        SparseSet* smallest = nullptr;
+
+        for (size_t i = 0; i < sparse_sets.size(); i++) {
+            if (!is_required[i]) {
+                continue;
+            }
+
+            if (!sparse_sets[i]) {
+                return nullptr;
+            }
+
+            if (!smallest || sparse_sets[i]->size() < smallest->size()) {
+                smallest = sparse_sets[i];
+            }
+        }
+
+        return smallest;
+    }
+
+    // Query iteration driven by a sparse set every match has to be in: calls
+    // `f` for the matching entities among `set`'s dense slots [first, last),
+    // found through their locations rather than by scanning archetypes.
+    template<typename... Terms, typename F>
+    void for_each_sparse_row(QueryCache& cache, SparseSet& set, SparseSet* const* sparse_sets, size_t first, size_t last, QueryTicks ticks, F& f)
+    {
+        [&]<size_t... I>(std::index_sequence<I...>) {
+            std::tuple<typename detail::QueryTerm<Terms>::Cursor...> cursors {};
+            std::array<uint32_t, sizeof...(Terms)> columns {};
+            Archetype* archetype = nullptr;
+            bool is_match = false;
+            size_t chunk = SIZE_MAX;
+
+            // Slots are re-read every iteration: `f` may add to the set.
+            for (auto dense = first; dense < last && dense < set.size(); dense++) {
+                auto const& location = m_entity_locations[entity_index(set.id_at(dense))];
+
+                if (location.archetype != archetype) {
+                    archetype = location.archetype;
+                    is_match = cache.matches(*archetype);
+                    chunk = SIZE_MAX;
+
+                    if (is_match) {
+                        columns = { archetype->column_index(component_id<typename detail::QueryTerm<Terms>::Component>())... };
+                    }
+                }
+
+                if (!is_match) {
+                    continue;
+                }
+
+                auto capacity = archetype->chunk_capacity();
+                auto index = location.row % capacity;
+
+                if (location.row / capacity != chunk) {
+                    chunk = location.row / capacity;
+                    (std::get<I>(cursors).begin_chunk(*archetype, chunk, columns[I], sparse_sets[I]), ...);
+                }
+
+                if (!(std::get<I>(cursors).matches(index, ticks) && ...)) {
+                    continue;
+                }
+
+                std::apply(f, std::tuple_cat(std::get<I>(cursors).fetch(index, ticks)...));
+            }
+        }(std::index_sequence_for<Terms...> {});
+    }
+
+    // Adds a T the entity doesn't have yet to its sparse set.
+    template<typename T>
+    void insert_sparse(EntityID id, T component)
+    {
+        auto storage = sparse_set(component_info<T>()).emplace_uninitialized(id, change_tick());
+
+        if constexpr (!is_tag_component<T>) {
+            new (storage) T(std::move(component));
+        }
+    }
+
+    template<typename T>
+    void add_sparse(EntityID id, T component)
+    {
+        check_alive(id);
+
+        auto& set = sparse_set(component_info<T>());
+        auto dense = set.find(id);
+
+        if (dense == SparseSet::npos) {
+            insert_sparse(id, std::move(component));
+            return;
+        }
+
+        if constexpr (!is_tag_component<T>) {
+            *static_cast<T*>(set.at(dense)) = std::move(component);
+            set.changed_tick_at(dense) = change_tick();
+        }
+    }
+
+    template<typename T>
+    T* try_get_sparse(EntityID id)
+    {
+        using Component = std::remove_const_t<T>;
+
+        auto set = find_sparse_set(component_id<Component>());
+        auto dense = set ? set->find(id) : SparseSet::npos;
+
+        if (dense == SparseSet::npos) {
+            return nullptr;
+        }
+
+        if constexpr (is_tag_component<Component>) {
+            return &detail::tag_instance<Component>();
+        } else {
+            if constexpr (!std::is_const_v<T>) {
+                set->changed_tick_at(dense) = change_tick();
+            }
+
+            return static_cast<T*>(set->at(dense));
+        }
+    }
+
+    // Start of T's column at row `index` of `chunk`, or nullptr for tags and
+    // sparse components.
+    template<typename T>
+    static T* column_data(Archetype& archetype, size_t chunk, uint32_t column, size_t index)
+    {
+        if constexpr (is_tag_component<T> || is_sparse_component<T>) {
+            return nullptr;
+        } else {
+            return static_cast<T*>(archetype.chunk_column(chunk, column)) + index;
+        }
+    }
+
+    template<typename T>
+    static void copy_into_column(Archetype& archetype, size_t chunk, size_t index, std::span<T const> values)
+    {
+        auto destination = column_data<T>(archetype, chunk, archetype.column_index(component_id<T>()), index);
+
+        if constexpr (is_tag_component<T> || is_sparse_component<T>) {
+            return;
+        } else if constexpr (std::is_trivially_copyable_v<T>) {
+            std::memcpy(destination, values.data(), values.size_bytes());
+        } else {
+            std::uninitialized_copy(values.begin(), values.end(), destination);
+        }
+    }
+
+    // Moves the entity's row to `target` and patches the locations of both the
+    // moved entity and the one swapped into its old row. Returns the new row.
+    size_t move_entity(EntityID id, Archetype& target);
+
+    // despawn() without fixing up the hierarchy.
+    void despawn_unlinked(EntityID id);
+
+    // Whether `ancestor` is `id` or one of its ancestors.
+    bool is_ancestor_or_self(EntityID ancestor, EntityID id);
+
+    // Sets Parent::depth for all descendants of `id`, which is at `depth`.
+    void update_subtree_depths(EntityID id, uint32_t depth);
+
+    std::vector<std::unique_ptr<Archetype>> m_archetypes;
+    std::unordered_map<ArchetypeSignature, Archetype*, ArchetypeSignatureHash, ArchetypeSignatureEqual> m_archetype_by_signature;
+    // Keyed by query key (see QueryCache).
+    std::unordered_map<ArchetypeSignature, QueryCache, ArchetypeSignatureHash, ArchetypeSignatureEqual> m_query_caches;
+    std::shared_mutex m_query_caches_mutex;
+    // Indexed by entity_index(). Recycled indices keep the table dense; only
+    // entries of live entities (per m_id_allocator) are meaningful.
+    std::vector<EntityLocation> m_entity_locations;
+    // Indexed by ComponentID; only sparse components that were ever added
+    // have a set. m_sparse_set_list holds the same sets, densely packed.
+    std::vector<std::unique_ptr<SparseSet>> m_sparse_sets;
+    std::vector<SparseSet*> m_sparse_set_list;
+    // Indexed by resource_id<Events<T>>().
+    std::vector<std::unique_ptr<EventChannelBase>> m_event_channels;
+    std::shared_mutex m_event_channels_mutex;
+    JobSystem* m_jobs { nullptr };
     IDAllocator m_id_allocator {};
+    // Bumped by track_changes() as well, so it's shared with concurrently
+    // running systems.
+    std::atomic<ChangeTick> m_change_tick { 1 };
+    ChangeTick m_last_change_tick { 0 };
+    uint64_t m_despawn_count {};
+    // Where the next compact() continues: an index into m_archetypes, then
+    // past them into m_sparse_set_list.
+    size_t m_compact_cursor {};
 };
 
 }
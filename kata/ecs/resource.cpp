@@ -0,0 +1,10 @@
+#include <atomic>
+#include <kata/ecs/resource.hpp>
+
+namespace kata::detail {
+ResourceID allocate_resource_id()
+{
+    static std::atomic<ResourceID> next_id { 0 };
+    return next_id.fetch_add(1, std::memory_order_relaxed);
+}
+}
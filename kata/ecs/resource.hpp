@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstdint>
+
+namespace kata {
+// Identifies resources (e.g. SpatialHashGrid) and event channels in
+// SystemAccess and the registry. Counted separately from ComponentIDs, so
+// resource types never show up in the component registry, snapshots or
+// component-indexed tables.
+using ResourceID = uint32_t;
+
+namespace detail {
+ResourceID allocate_resource_id();
+}
+
+template<typename T>
+ResourceID resource_id()
+{
+    static ResourceID id = detail::allocate_resource_id();
+    return id;
+}
+}
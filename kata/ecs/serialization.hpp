@@ -0,0 +1,130 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <span>
+#include <type_traits>
+
+namespace kata {
+// Sequential binary output used by snapshots and SnapshotSerializable
+// components. Values are written in native byte order.
+class SnapshotWriter {
+public:
+    explicit SnapshotWriter(std::ostream& stream)
+        : m_stream(&stream)
+    {
+    }
+
+    void write(void const* data, size_t size)
+    {
+        m_stream->write(static_cast<char const*>(data), std::streamsize(size));
+        m_offset += size;
+    }
+
+    template<typename T>
+        requires std::is_trivially_copyable_v<T>
+    void write_value(T const& value)
+    {
+        write(&value, sizeof(T));
+    }
+
+    template<typename T>
+        requires std::is_trivially_copyable_v<T>
+    void write_span(std::span<T const> values)
+    {
+        write_value(uint64_t(values.size()));
+        write(values.data(), values.size_bytes());
+    }
+
+    // Pads with zeros up to the next multiple of `alignment`.
+    void align_to(size_t alignment)
+    {
+        static constexpr std::byte zeros[64] {};
+
+        while (m_offset % alignment != 0) {
+            write(zeros, std::min(alignment - m_offset % alignment, sizeof(zeros)));
+        }
+    }
+
+    bool failed() const
+    {
+        return m_stream->fail();
+    }
+
+private:
+    std::ostream* m_stream { nullptr };
+    size_t m_offset {};
+};
+
+// Reads what SnapshotWriter wrote, straight from memory (usually a
+// MappedFile). Reading past the end puts the reader into the failed state, in
+// which it returns zeros and empty spans, so loaders don't need to check
+// every read.
+class SnapshotReader {
+public:
+    explicit SnapshotReader(std::span<std::byte const> data)
+        : m_data(data)
+    {
+    }
+
+    // Returns the next `size` bytes without copying them.
+    std::span<std::byte const> read_bytes(size_t size)
+    {
+        if (m_failed || size > m_data.size() - m_offset) {
+            m_failed = true;
+            return {};
+        }
+
+        auto bytes = m_data.subspan(m_offset, size);
+        m_offset += size;
+
+        return bytes;
+    }
+
+    template<typename T>
+        requires std::is_trivially_copyable_v<T>
+    T read_value()
+    {
+        T value {};
+        auto bytes = read_bytes(sizeof(T));
+
+        if (!bytes.empty()) {
+            std::memcpy(&value, bytes.data(), sizeof(T));
+        }
+
+        return value;
+    }
+
+    // Reads what SnapshotWriter::write_span() wrote. The data points into
+    // the reader's memory and may be unaligned, so copy it out with memcpy.
+    std::span<std::byte const> read_span(size_t element_size)
+    {
+        auto count = read_value<uint64_t>();
+        if (element_size != 0 && count > (m_data.size() - m_offset) / element_size) {
+            m_failed = true;
+            return {};
+        }
+
+        return read_bytes(count * element_size);
+    }
+
+    void align_to(size_t alignment)
+    {
+        auto padding = (alignment - m_offset % alignment) % alignment;
+        read_bytes(padding);
+    }
+
+    bool failed() const
+    {
+        return m_failed;
+    }
+
+private:
+    std::span<std::byte const> m_data {};
+    size_t m_offset {};
+    bool m_failed { false };
+};
+}
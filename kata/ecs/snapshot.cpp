@@ -0,0 +1,376 @@
+#include <cstring>
+#include <fstream>
+#include <kata/core/mapped_file.hpp>
+#include <kata/ecs/registry.hpp>
+#include <kata/ecs/serialization.hpp>
+
+// Snapshot layout, all integers in native byte order:
+//
+//   magic "KATASNAP", u32 version, u32 archetype count, u32 sparse set count
+//   IDAllocator generations and free indices (u64 count + u32 each)
+//   per non-empty archetype:
+//     u32 component count, u64 row count, component headers
+//     entity IDs, then one block per non-tag component in header order
+//   per non-empty sparse set:
+//     component header, entity IDs (u64 count + IDs), values
+//
+// A component header is its name (u64 length + chars), u64 size, u64
+// alignment and u8 encoding. Raw blocks start on a 64-byte boundary, so a
+// column is a single run of bytes that can be copied chunk by chunk straight
+// out of the mapped file.
+//
+// Components are matched by name, not ID, since IDs depend on the order
+// components are first used in a process. Names come from
+// __PRETTY_FUNCTION__ / __FUNCSIG__, whose spelling differs between
+// compilers, so snapshots only load in builds from the same compiler.
+
+namespace kata {
+static constexpr char snapshot_magic[8] { 'K', 'A', 'T', 'A', 'S', 'N', 'A', 'P' };
+static constexpr uint32_t snapshot_version = 1;
+static constexpr size_t snapshot_block_alignment = 64;
+
+enum class ComponentEncoding : uint8_t {
+    Raw,
+    Serialized,
+    Tag,
+};
+
+static Result<ComponentEncoding> encoding_of(ComponentInfo const& info)
+{
+    if (info.is_tag) {
+        return ComponentEncoding::Tag;
+    }
+
+    if (info.is_trivially_copyable) {
+        return ComponentEncoding::Raw;
+    }
+
+    if (info.save) {
+        return ComponentEncoding::Serialized;
+    }
+
+    return Error::with_message(std::string("Component `") + std::string(info.name) + "` is neither trivially copyable nor SnapshotSerializable");
+}
+
+static Error write_component_header(SnapshotWriter& writer, ComponentInfo const& info)
+{
+    auto [encoding, err] = encoding_of(info);
+    OR_RETURN(err);
+
+    writer.write_span(std::span<char const>(info.name));
+    writer.write_value(uint64_t(info.size));
+    writer.write_value(uint64_t(info.alignment));
+    writer.write_value(encoding);
+
+    return {};
+}
+
+// Resolves a component header against the components registered in this
+// process.
+static Result<ComponentInfo const*> read_component_header(SnapshotReader& reader)
+{
+    auto name_bytes = reader.read_span(1);
+    std::string_view name(reinterpret_cast<char const*>(name_bytes.data()), name_bytes.size());
+    auto size = reader.read_value<uint64_t>();
+    auto alignment = reader.read_value<uint64_t>();
+    auto encoding = reader.read_value<ComponentEncoding>();
+
+    if (reader.failed()) {
+        return Error::with_message("Snapshot is truncated");
+    }
+
+    auto info = detail::find_component(name);
+    if (!info) {
+        return Error::with_message(std::string("Snapshot contains unregistered component `") + std::string(name) + "`");
+    }
+
+    auto [expected, err] = encoding_of(*info);
+    if (err || expected != encoding || info->size != size || info->alignment != alignment) {
+        return Error::with_message(std::string("Layout of component `") + std::string(name) + "` doesn't match the snapshot");
+    }
+
+    if (encoding == ComponentEncoding::Serialized && !info->load) {
+        return Error::with_message(std::string("Component `") + std::string(name) + "` can't be loaded");
+    }
+
+    return info;
+}
+
+Error Registry::save_snapshot(std::filesystem::path const& path)
+{
+    std::ofstream stream(path, std::ios::binary | std::ios::trunc);
+    if (!stream) {
+        return Error::with_message("Failed to open " + path.string() + " for writing");
+    }
+
+    SnapshotWriter writer(stream);
+
+    auto archetype_count = std::count_if(m_archetypes.begin(), m_archetypes.end(), [](auto const& archetype) {
+        return archetype->size() > 0;
+    });
+    auto sparse_set_count = std::count_if(m_sparse_set_list.begin(), m_sparse_set_list.end(), [](auto set) {
+        return set->size() > 0;
+    });
+
+    writer.write(snapshot_magic, sizeof(snapshot_magic));
+    writer.write_value(snapshot_version);
+    writer.write_value(uint32_t(archetype_count));
+    writer.write_value(uint32_t(sparse_set_count));
+    writer.write_span(m_id_allocator.generations());
+    writer.write_span(m_id_allocator.free_indices());
+
+    for (auto& archetype : m_archetypes) {
+        if (archetype->size() == 0) {
+            continue;
+        }
+
+        writer.write_value(uint32_t(archetype->components().size()));
+        writer.write_value(uint64_t(archetype->size()));
+
+        for (auto info : archetype->components()) {
+            auto err = write_component_header(writer, *info);
+            OR_RETURN(err);
+        }
+
+        writer.align_to(snapshot_block_alignment);
+
+        for (size_t chunk = 0; chunk < archetype->chunk_count(); chunk++) {
+            writer.write(archetype->chunk_ids(chunk), archetype->chunk_row_count(chunk) * sizeof(EntityID));
+        }
+
+        for (auto info : archetype->components()) {
+            if (info->is_tag) {
+                continue;
+            }
+
+            auto column = archetype->column_index(info->id);
+
+            if (info->is_trivially_copyable) {
+                writer.align_to(snapshot_block_alignment);
+
+                for (size_t chunk = 0; chunk < archetype->chunk_count(); chunk++) {
+                    writer.write(archetype->chunk_column(chunk, column), archetype->chunk_row_count(chunk) * info->size);
+                }
+            } else {
+                for (size_t row = 0; row < archetype->size(); row++) {
+                    info->save(writer, archetype->at(column, row));
+                }
+            }
+        }
+    }
+
+    for (auto set : m_sparse_set_list) {
+        if (set->size() == 0) {
+            continue;
+        }
+
+        auto& info = set->info();
+
+        auto err = write_component_header(writer, info);
+        OR_RETURN(err);
+
+        writer.write_span(set->ids());
+
+        if (info.is_tag) {
+            continue;
+        }
+
+        if (info.is_trivially_copyable) {
+            writer.align_to(snapshot_block_alignment);
+            writer.write(set->at(0), set->size() * info.size);
+        } else {
+            for (size_t dense = 0; dense < set->size(); dense++) {
+                info.save(writer, set->at(dense));
+            }
+        }
+    }
+
+    stream.flush();
+
+    if (writer.failed()) {
+        return Error::with_message("Failed to write " + path.string());
+    }
+
+    return {};
+}
+
+// Reads u32s written by SnapshotWriter::write_span().
+static std::vector<uint32_t> read_u32s(SnapshotReader& reader)
+{
+    auto bytes = reader.read_span(sizeof(uint32_t));
+
+    std::vector<uint32_t> values(bytes.size() / sizeof(uint32_t));
+    if (!bytes.empty()) {
+        std::memcpy(values.data(), bytes.data(), bytes.size());
+    }
+
+    return values;
+}
+
+Error Registry::load_snapshot(std::filesystem::path const& path)
+{
+    assert(m_id_allocator.index_end() == 0 && "snapshots can only be loaded into an empty registry");
+
+    auto [file, err] = MappedFile::open(path);
+    OR_RETURN(err);
+
+    SnapshotReader reader(file.bytes());
+
+    auto magic = reader.read_bytes(sizeof(snapshot_magic));
+    if (magic.size() != sizeof(snapshot_magic) || std::memcmp(magic.data(), snapshot_magic, sizeof(snapshot_magic)) != 0) {
+        return Error::with_message(path.string() + " is not a snapshot");
+    }
+
+    if (reader.read_value<uint32_t>() != snapshot_version) {
+        return Error::with_message(path.string() + " has an unsupported snapshot version");
+    }
+
+    auto archetype_count = reader.read_value<uint32_t>();
+    auto sparse_set_count = reader.read_value<uint32_t>();
+    auto generations = read_u32s(reader);
+    auto free_indices = read_u32s(reader);
+
+    m_id_allocator.restore(std::move(generations), std::move(free_indices));
+    m_entity_locations.resize(m_id_allocator.index_end());
+
+    std::vector<ComponentInfo const*> infos;
+
+    for (uint32_t a = 0; a < archetype_count; a++) {
+        auto component_count = reader.read_value<uint32_t>();
+        auto rows = reader.read_value<uint64_t>();
+        if (rows > file.bytes().size() / sizeof(EntityID)) {
+            return Error::with_message("Snapshot is corrupted");
+        }
+
+        infos.clear();
+
+        for (uint32_t c = 0; c < component_count && !reader.failed(); c++) {
+            auto [info, err] = read_component_header(reader);
+            OR_RETURN(err);
+
+            infos.push_back(info);
+        }
+
+        reader.align_to(snapshot_block_alignment);
+
+        // Blocks are 8-byte aligned within the file and the mapping is page
+        // aligned, so the IDs can be used in place.
+        auto id_bytes = reader.read_bytes(rows * sizeof(EntityID));
+        if (reader.failed()) {
+            return Error::with_message("Snapshot is truncated");
+        }
+
+        std::span<EntityID const> ids(reinterpret_cast<EntityID const*>(id_bytes.data()), rows);
+
+        for (auto id : ids) {
+            if (!m_id_allocator.is_alive(id) || m_entity_locations[entity_index(id)].archetype) {
+                return Error::with_message("Snapshot contains an invalid entity ID");
+            }
+        }
+
+        std::vector<ComponentID> signature(infos.size());
+        std::transform(infos.begin(), infos.end(), signature.begin(), [](auto info) { return info->id; });
+        std::sort(signature.begin(), signature.end());
+
+        if (std::adjacent_find(signature.begin(), signature.end()) != signature.end()) {
+            return Error::with_message("Snapshot is corrupted");
+        }
+
+        auto archetype = find_archetype(signature);
+        if (!archetype) {
+            archetype = &create_archetype(infos);
+        }
+
+        auto first_row = archetype->push_rows_uninitialized(ids, change_tick());
+
+        for (size_t i = 0; i < rows; i++) {
+            m_entity_locations[entity_index(ids[i])] = EntityLocation {
+                .archetype = archetype,
+                .row = first_row + i,
+            };
+        }
+
+        // Blocks follow the file's header order, which needn't match this
+        // process's column order since component IDs depend on registration
+        // order. Every column is constructed even if the reader runs out of
+        // data: it then yields zeros, which leaves the rows valid if
+        // meaningless.
+        for (auto info : infos) {
+            if (info->is_tag) {
+                continue;
+            }
+
+            auto column = archetype->column_index(info->id);
+
+            if (info->is_trivially_copyable) {
+                reader.align_to(snapshot_block_alignment);
+                auto bytes = reader.read_bytes(rows * info->size);
+
+                archetype->for_each_chunk_segment(first_row, rows, [&](size_t chunk, size_t index, size_t count, size_t done) {
+                    auto destination = static_cast<std::byte*>(archetype->chunk_column(chunk, column)) + index * info->size;
+
+                    if (bytes.empty()) {
+                        std::memset(destination, 0, count * info->size);
+                    } else {
+                        std::memcpy(destination, bytes.data() + done * info->size, count * info->size);
+                    }
+                });
+            } else {
+                for (size_t i = 0; i < rows; i++) {
+                    info->load(reader, archetype->at(column, first_row + i));
+                }
+            }
+        }
+    }
+
+    for (uint32_t s = 0; s < sparse_set_count; s++) {
+        auto [info, err] = read_component_header(reader);
+        OR_RETURN(err);
+
+        // Unlike archetype IDs these aren't padded, so they're copied out.
+        auto id_bytes = reader.read_span(sizeof(EntityID));
+        std::vector<EntityID> ids(id_bytes.size() / sizeof(EntityID));
+        if (!id_bytes.empty()) {
+            std::memcpy(ids.data(), id_bytes.data(), id_bytes.size());
+        }
+
+        auto count = ids.size();
+
+        auto& set = sparse_set(*info);
+
+        for (auto id : ids) {
+            if (!is_alive(id) || set.contains(id)) {
+                return Error::with_message("Snapshot contains an invalid entity ID");
+            }
+        }
+
+        std::span<std::byte const> values;
+        if (info->is_trivially_copyable && !info->is_tag) {
+            reader.align_to(snapshot_block_alignment);
+            values = reader.read_bytes(count * info->size);
+        }
+
+        for (size_t dense = 0; dense < count; dense++) {
+            auto storage = set.emplace_uninitialized(ids[dense], change_tick());
+
+            if (info->is_tag) {
+                continue;
+            }
+
+            if (!info->is_trivially_copyable) {
+                info->load(reader, storage);
+            } else if (values.empty()) {
+                std::memset(storage, 0, info->size);
+            } else {
+                std::memcpy(storage, values.data() + dense * info->size, info->size);
+            }
+        }
+    }
+
+    if (reader.failed()) {
+        return Error::with_message("Snapshot is truncated");
+    }
+
+    return {};
+}
+}
@@ -0,0 +1,142 @@
+#include <algorithm>
+#include <kata/ecs/sparse_set.hpp>
+#include <new>
+
+namespace kata {
+static std::align_val_t data_alignment(ComponentInfo const& info)
+{
+    return std::align_val_t(std::max(info.alignment, alignof(std::max_align_t)));
+}
+
+SparseSet::~SparseSet()
+{
+    if (!m_data) {
+        return;
+    }
+
+    for (size_t dense = 0; dense < m_ids.size(); dense++) {
+        destroy_component(*m_info, at(dense));
+    }
+
+    ::operator delete(m_data, data_alignment(*m_info));
+}
+
+void* SparseSet::emplace_uninitialized(EntityID id, ChangeTick tick)
+{
+    assert(!contains(id));
+
+    auto index = entity_index(id);
+    if (index >= m_sparse.size()) {
+        m_sparse.resize(std::max<size_t>(index + 1, m_sparse.size() * 2));
+    }
+
+    auto dense = m_ids.size();
+
+    if (!m_info->is_tag && dense == m_capacity) {
+        grow();
+    }
+
+    m_sparse[index] = uint32_t(dense + 1);
+    m_ids.push_back(id);
+    m_added_ticks.push_back(tick);
+    m_changed_ticks.push_back(tick);
+
+    return m_info->is_tag ? nullptr : at(dense);
+}
+
+void SparseSet::remove(EntityID id)
+{
+    auto dense = find(id);
+    if (dense == npos) {
+        return;
+    }
+
+    auto last = m_ids.size() - 1;
+
+    if (!m_info->is_tag) {
+        destroy_component(*m_info, at(dense));
+
+        if (dense != last) {
+            relocate_component(*m_info, at(dense), at(last));
+        }
+    }
+
+    if (dense != last) {
+        m_ids[dense] = m_ids[last];
+        m_added_ticks[dense] = m_added_ticks[last];
+        m_changed_ticks[dense] = m_changed_ticks[last];
+        m_sparse[entity_index(m_ids[dense])] = uint32_t(dense + 1);
+    }
+
+    m_sparse[entity_index(id)] = 0;
+    m_ids.pop_back();
+    m_added_ticks.pop_back();
+    m_changed_ticks.pop_back();
+}
+
+void SparseSet::forget_all()
+{
+    for (auto id : m_ids) {
+        m_sparse[entity_index(id)] = 0;
+    }
+
+    m_ids.clear();
+    m_added_ticks.clear();
+    m_changed_ticks.clear();
+}
+
+size_t SparseSet::shrink_to_fit()
+{
+    auto capacity_bytes = [&] {
+        auto bytes = m_sparse.capacity() * sizeof(uint32_t) + m_ids.capacity() * sizeof(EntityID)
+            + (m_added_ticks.capacity() + m_changed_ticks.capacity()) * sizeof(ChangeTick);
+
+        return bytes + (m_info->is_tag ? 0 : m_capacity * m_info->size);
+    };
+
+    auto before = capacity_bytes();
+
+    // Trailing sparse entries only ever point at removed entities.
+    auto sparse_end = m_sparse.size();
+    while (sparse_end > 0 && m_sparse[sparse_end - 1] == 0) {
+        sparse_end--;
+    }
+
+    m_sparse.resize(sparse_end);
+    m_sparse.shrink_to_fit();
+    m_ids.shrink_to_fit();
+    m_added_ticks.shrink_to_fit();
+    m_changed_ticks.shrink_to_fit();
+
+    if (!m_info->is_tag && m_capacity > m_ids.size()) {
+        reallocate(m_ids.size());
+    }
+
+    return before - capacity_bytes();
+}
+
+void SparseSet::reallocate(size_t capacity)
+{
+    std::byte* data = nullptr;
+
+    if (capacity > 0) {
+        data = static_cast<std::byte*>(::operator new(capacity * m_info->size, data_alignment(*m_info)));
+    }
+
+    for (size_t dense = 0; dense < m_ids.size(); dense++) {
+        relocate_component(*m_info, data + dense * m_info->size, at(dense));
+    }
+
+    if (m_data) {
+        ::operator delete(m_data, data_alignment(*m_info));
+    }
+
+    m_data = data;
+    m_capacity = capacity;
+}
+
+void SparseSet::grow()
+{
+    reallocate(std::max<size_t>(m_capacity * 2, 16));
+}
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <cstddef>
+#include <kata/ecs/archetype.hpp>
+#include <kata/ecs/component.hpp>
+#include <kata/ecs/id_allocator.hpp>
+#include <span>
+#include <vector>
+
+namespace kata {
+// Storage for one sparse component (see StoragePolicy). Values are packed
+// densely; a sparse table indexed by entity_index() maps entities to their
+// dense slot, so lookup, insertion and removal are O(1) and never touch the
+// entity's archetype row.
+class SparseSet {
+public:
+    static constexpr size_t npos = SIZE_MAX;
+
+    explicit SparseSet(ComponentInfo const& info)
+        : m_info(&info)
+    {
+    }
+
+    ~SparseSet();
+
+    SparseSet(SparseSet const&) = delete;
+    SparseSet& operator=(SparseSet const&) = delete;
+
+    ComponentInfo const& info() const
+    {
+        return *m_info;
+    }
+
+    size_t size() const
+    {
+        return m_ids.size();
+    }
+
+    // Dense slot of the entity's component, or npos.
+    size_t find(EntityID id) const
+    {
+        auto index = entity_index(id);
+        if (index >= m_sparse.size() || m_sparse[index] == 0) {
+            return npos;
+        }
+
+        auto dense = m_sparse[index] - 1;
+
+        return m_ids[dense] == id ? dense : npos;
+    }
+
+    bool contains(EntityID id) const
+    {
+        return find(id) != npos;
+    }
+
+    // Tags have no storage; this is only valid for other components.
+    void* at(size_t dense)
+    {
+        return m_data + dense * m_info->size;
+    }
+
+    EntityID id_at(size_t dense) const
+    {
+        return m_ids[dense];
+    }
+
+    // Entities in dense order, matching the layout of the component data.
+    std::span<EntityID const> ids() const
+    {
+        return m_ids;
+    }
+
+    ChangeTick& added_tick_at(size_t dense)
+    {
+        return m_added_ticks[dense];
+    }
+
+    ChangeTick& changed_tick_at(size_t dense)
+    {
+        return m_changed_ticks[dense];
+    }
+
+    // Adds a slot for `id`, which must not be in the set yet, and returns its
+    // storage for the caller to construct the component in. Returns nullptr
+    // for tags.
+    void* emplace_uninitialized(EntityID id, ChangeTick tick);
+
+    // Destroys the entity's component, if it has one. The last slot is moved
+    // into the hole.
+    void remove(EntityID id);
+
+    // Empties the set without destroying the values, for when they have
+    // already been relocated elsewhere.
+    void forget_all();
+
+    // Releases storage beyond what the current values need and returns the
+    // number of bytes freed.
+    size_t shrink_to_fit();
+
+private:
+    // Moves the values to new storage for `capacity` of them.
+    void reallocate(size_t capacity);
+    void grow();
+
+    ComponentInfo const* m_info { nullptr };
+
+    // Indexed by entity_index(): dense slot + 1, or 0 if absent.
+    std::vector<uint32_t> m_sparse {};
+    std::vector<EntityID> m_ids {};
+    std::vector<ChangeTick> m_added_ticks {};
+    std::vector<ChangeTick> m_changed_ticks {};
+
+    std::byte* m_data { nullptr };
+    size_t m_capacity {};
+};
+}
@@ -0,0 +1,187 @@
+#include <algorithm>
+#include <cstdlib>
+#include <kata/ecs/spatial_hash.hpp>
+#include <utility>
+
+namespace kata {
+void SpatialHashGrid::update(EntityID id, Vec3 position)
+{
+    auto index = entity_index(id);
+    if (index >= m_slots.size()) {
+        m_slots.resize(std::max<size_t>(index + 1, m_slots.size() * 2));
+    }
+
+    auto coord = cell_coord_of(position);
+    auto& slot = m_slots[index];
+
+    if (slot.id == id) {
+        auto& cell = m_cells[slot.cell];
+        auto c = cell.coord;
+
+        if (c.x == coord.x && c.y == coord.y && c.z == coord.z) {
+            cell.positions[slot.index] = position;
+            return;
+        }
+
+        remove_from_cell(slot.cell, slot.index);
+    } else if (slot.id != null_entity) {
+        // A stale entry for a previous entity with the same index.
+        remove_from_cell(slot.cell, slot.index);
+    }
+
+    auto cell = cell_index(coord);
+
+    m_slots[index] = Slot {
+        .id = id,
+        .cell = cell,
+        .index = uint32_t(m_cells[cell].ids.size()),
+    };
+    m_cells[cell].ids.push_back(id);
+    m_cells[cell].positions.push_back(position);
+    m_size++;
+}
+
+void SpatialHashGrid::remove(EntityID id)
+{
+    if (auto slot = find_slot(id)) {
+        remove_from_cell(slot->cell, slot->index);
+    }
+}
+
+void SpatialHashGrid::clear()
+{
+    m_cells.clear();
+    m_cell_by_key.clear();
+    m_slots.clear();
+    m_size = 0;
+}
+
+void SpatialHashGrid::query_nearest(Vec3 point, size_t k, std::vector<EntityID>& out) const
+{
+    out.clear();
+
+    if (k == 0 || m_size == 0) {
+        return;
+    }
+
+    // Max-heap of the best candidates so far, by squared distance.
+    std::vector<std::pair<float, EntityID>> best;
+    best.reserve(k);
+
+    auto consider = [&](Cell const& cell) {
+        for (size_t i = 0; i < cell.ids.size(); i++) {
+            auto candidate = std::pair(distance_squared(cell.positions[i], point), cell.ids[i]);
+
+            if (best.size() < k) {
+                best.push_back(candidate);
+                std::push_heap(best.begin(), best.end());
+            } else if (candidate < best.front()) {
+                std::pop_heap(best.begin(), best.end());
+                best.back() = candidate;
+                std::push_heap(best.begin(), best.end());
+            }
+        }
+    };
+
+    // Visit cells in growing cubic shells around the point's cell. After
+    // shell r, everything unvisited is at least r cells away, so the search
+    // can stop once the k-th best candidate is closer than that.
+    auto center = cell_coord_of(point);
+    size_t visited = 0;
+
+    for (int32_t ring = 0;; ring++) {
+        auto side = double(2 * ring + 1);
+        auto shell_cells = side * side * side - (side - 2) * (side - 2) * (side - 2);
+
+        if (ring > 0 && shell_cells > double(m_cell_by_key.size())) {
+            // The shells have outgrown the grid: scan the remaining cells directly.
+            for (auto const& cell : m_cells) {
+                auto c = cell.coord;
+                auto distance = std::max({ std::abs(c.x - center.x), std::abs(c.y - center.y), std::abs(c.z - center.z) });
+
+                if (distance >= ring) {
+                    consider(cell);
+                }
+            }
+
+            break;
+        }
+
+        for (auto z = -ring; z <= ring; z++) {
+            for (auto y = -ring; y <= ring; y++) {
+                // Inner rows only have their two end cells on the shell.
+                auto on_face = std::abs(z) == ring || std::abs(y) == ring;
+                auto step = on_face || ring == 0 ? 1 : 2 * ring;
+
+                for (auto x = -ring; x <= ring; x += step) {
+                    if (auto cell = find_cell({ center.x + x, center.y + y, center.z + z })) {
+                        consider(*cell);
+                        visited += cell->ids.size();
+                    }
+                }
+            }
+        }
+
+        if (visited == m_size) {
+            break;
+        }
+
+        auto reach = float(ring) * m_cell_size;
+        if (best.size() == k && best.front().first <= reach * reach) {
+            break;
+        }
+    }
+
+    std::sort_heap(best.begin(), best.end());
+
+    out.reserve(best.size());
+    for (auto const& candidate : best) {
+        out.push_back(candidate.second);
+    }
+}
+
+uint32_t SpatialHashGrid::cell_index(CellCoord coord)
+{
+    auto [it, inserted] = m_cell_by_key.try_emplace(cell_key(coord), uint32_t(m_cells.size()));
+
+    if (inserted) {
+        m_cells.push_back(Cell { .coord = coord });
+    }
+
+    return it->second;
+}
+
+void SpatialHashGrid::remove_from_cell(uint32_t cell, uint32_t index)
+{
+    auto& ids = m_cells[cell].ids;
+    auto& positions = m_cells[cell].positions;
+    auto last = ids.size() - 1;
+
+    m_slots[entity_index(ids[index])].id = null_entity;
+
+    if (index != last) {
+        ids[index] = ids[last];
+        positions[index] = positions[last];
+        m_slots[entity_index(ids[index])].index = index;
+    }
+
+    ids.pop_back();
+    positions.pop_back();
+    m_size--;
+}
+
+void SpatialIndexSystem::run(Registry& reg)
+{
+    if (reg.despawn_count() != m_despawn_count) {
+        m_despawn_count = reg.despawn_count();
+
+        m_grid->remove_if([&](EntityID id) {
+            return !reg.is_alive(id);
+        });
+    }
+
+    reg.query<Entity, GlobalTransform const, Changed<GlobalTransform>>(reg.track_changes(m_changes), [&](EntityID id, GlobalTransform const& global) {
+        m_grid->update(id, global.value.translation);
+    });
+}
+}
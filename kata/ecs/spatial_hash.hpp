@@ -0,0 +1,246 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <kata/core/math.hpp>
+#include <kata/ecs/id_allocator.hpp>
+#include <kata/ecs/system.hpp>
+#include <kata/ecs/transform.hpp>
+#include <unordered_map>
+#include <vector>
+
+namespace kata {
+// Axis-aligned box given by its minimum and maximum corners.
+struct Aabb {
+    Vec3 min {};
+    Vec3 max {};
+};
+
+// Uniform grid of cubic cells over entity positions. Only occupied cells are
+// stored, in a hash map keyed by cell coordinates, so the world doesn't need
+// bounds. Updating an entity is O(1); radius and box queries only look at
+// the cells overlapping the query shape.
+//
+// Cell size should be on the order of typical query radii: much smaller
+// cells make queries visit many cells, much larger ones make them test many
+// far-away entities.
+class SpatialHashGrid {
+public:
+    explicit SpatialHashGrid(float cell_size)
+        : m_cell_size(cell_size)
+        , m_inverse_cell_size(1.0f / cell_size)
+    {
+    }
+
+    float cell_size() const
+    {
+        return m_cell_size;
+    }
+
+    // Number of indexed entities.
+    size_t size() const
+    {
+        return m_size;
+    }
+
+    bool contains(EntityID id) const
+    {
+        return find_slot(id) != nullptr;
+    }
+
+    // Inserts the entity or moves it to `position`.
+    void update(EntityID id, Vec3 position);
+
+    // Does nothing if the entity isn't indexed.
+    void remove(EntityID id);
+
+    // Removes every entity for which `predicate(id)` returns true.
+    template<typename F>
+    void remove_if(F predicate)
+    {
+        for (uint32_t cell = 0; cell < m_cells.size(); cell++) {
+            auto& ids = m_cells[cell].ids;
+
+            for (size_t i = ids.size(); i-- > 0;) {
+                if (predicate(ids[i])) {
+                    remove_from_cell(cell, uint32_t(i));
+                }
+            }
+        }
+    }
+
+    void clear();
+
+    // Calls f(id, position) for every entity within `radius` of `center`.
+    template<typename F>
+    void query_radius(Vec3 center, float radius, F f) const
+    {
+        auto radius_squared = radius * radius;
+        Vec3 extent { radius, radius, radius };
+
+        for_each_cell_overlapping(center - extent, center + extent, [&](Cell const& cell) {
+            for (size_t i = 0; i < cell.ids.size(); i++) {
+                if (distance_squared(cell.positions[i], center) <= radius_squared) {
+                    f(cell.ids[i], cell.positions[i]);
+                }
+            }
+        });
+    }
+
+    // Calls f(id, position) for every entity inside `box`, bounds included.
+    template<typename F>
+    void query_aabb(Aabb const& box, F f) const
+    {
+        for_each_cell_overlapping(box.min, box.max, [&](Cell const& cell) {
+            for (size_t i = 0; i < cell.ids.size(); i++) {
+                auto p = cell.positions[i];
+
+                if (p.x >= box.min.x && p.y >= box.min.y && p.z >= box.min.z && p.x <= box.max.x && p.y <= box.max.y && p.z <= box.max.z) {
+                    f(cell.ids[i], p);
+                }
+            }
+        });
+    }
+
+    // Replaces `out` with the (up to) `k` entities closest to `point`,
+    // nearest first.
+    void query_nearest(Vec3 point, size_t k, std::vector<EntityID>& out) const;
+
+private:
+    struct CellCoord {
+        int32_t x {};
+        int32_t y {};
+        int32_t z {};
+    };
+
+    // Entities are stored per cell as parallel arrays, so scanning a cell
+    // only touches positions.
+    struct Cell {
+        CellCoord coord {};
+        std::vector<EntityID> ids {};
+        std::vector<Vec3> positions {};
+    };
+
+    struct Slot {
+        EntityID id { null_entity };
+        uint32_t cell {};
+        uint32_t index {};
+    };
+
+    static float distance_squared(Vec3 a, Vec3 b)
+    {
+        auto d = a - b;
+        return d.x * d.x + d.y * d.y + d.z * d.z;
+    }
+
+    // Coordinates are clamped to 21 bits each so they pack into one key.
+    static constexpr int32_t coord_limit = (1 << 20) - 1;
+
+    int32_t coord_of(float value) const
+    {
+        auto coord = std::floor(value * m_inverse_cell_size);
+
+        return int32_t(std::fmax(-coord_limit, std::fmin(coord, coord_limit)));
+    }
+
+    CellCoord cell_coord_of(Vec3 position) const
+    {
+        return { coord_of(position.x), coord_of(position.y), coord_of(position.z) };
+    }
+
+    static uint64_t cell_key(CellCoord coord)
+    {
+        constexpr uint64_t mask = (uint64_t(1) << 21) - 1;
+
+        return (uint64_t(coord.x) & mask) | ((uint64_t(coord.y) & mask) << 21) | ((uint64_t(coord.z) & mask) << 42);
+    }
+
+    Cell const* find_cell(CellCoord coord) const
+    {
+        auto it = m_cell_by_key.find(cell_key(coord));
+        return it != m_cell_by_key.end() ? &m_cells[it->second] : nullptr;
+    }
+
+    Slot const* find_slot(EntityID id) const
+    {
+        auto index = entity_index(id);
+        if (index >= m_slots.size() || m_slots[index].id != id) {
+            return nullptr;
+        }
+
+        return &m_slots[index];
+    }
+
+    // Calls f(cell) for every occupied cell overlapping [min, max]. Falls
+    // back to scanning all occupied cells when that's fewer.
+    template<typename F>
+    void for_each_cell_overlapping(Vec3 min, Vec3 max, F f) const
+    {
+        auto first = cell_coord_of(min);
+        auto last = cell_coord_of(max);
+        auto cell_count = double(last.x - first.x + 1) * double(last.y - first.y + 1) * double(last.z - first.z + 1);
+
+        if (cell_count > double(m_cell_by_key.size())) {
+            for (auto const& cell : m_cells) {
+                auto c = cell.coord;
+
+                if (!cell.ids.empty() && c.x >= first.x && c.y >= first.y && c.z >= first.z && c.x <= last.x && c.y <= last.y && c.z <= last.z) {
+                    f(cell);
+                }
+            }
+
+            return;
+        }
+
+        for (auto z = first.z; z <= last.z; z++) {
+            for (auto y = first.y; y <= last.y; y++) {
+                for (auto x = first.x; x <= last.x; x++) {
+                    if (auto cell = find_cell({ x, y, z })) {
+                        f(*cell);
+                    }
+                }
+            }
+        }
+    }
+
+    uint32_t cell_index(CellCoord coord);
+    void remove_from_cell(uint32_t cell, uint32_t index);
+
+    float m_cell_size {};
+    float m_inverse_cell_size {};
+    size_t m_size {};
+
+    // Cells are never freed, only emptied, so indices into m_cells stay valid.
+    std::vector<Cell> m_cells {};
+    std::unordered_map<uint64_t, uint32_t> m_cell_by_key {};
+    // Indexed by entity_index().
+    std::vector<Slot> m_slots {};
+};
+
+// Keeps a SpatialHashGrid in sync with GlobalTransform translations. Only
+// entities whose GlobalTransform changed since the system's previous run are
+// re-binned, so it doesn't matter where it runs relative to
+// TransformPropagationSystem; scheduled before it, the grid lags one frame
+// behind. Despawned entities are dropped in a sweep that only runs when
+// something was despawned. Entities that merely lose their GlobalTransform
+// stay in the grid until they're despawned.
+class SpatialIndexSystem : public System {
+public:
+    explicit SpatialIndexSystem(SpatialHashGrid& grid)
+        : m_grid(&grid)
+    {
+    }
+
+    virtual void run(Registry& reg) override;
+
+    virtual SystemAccess access() const override
+    {
+        return SystemAccess {}.read<GlobalTransform>().write_resource<SpatialHashGrid>();
+    }
+
+private:
+    SpatialHashGrid* m_grid { nullptr };
+    ChangeTracker m_changes {};
+    uint64_t m_despawn_count {};
+};
+}
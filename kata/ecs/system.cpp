@@ -1,15 +1,146 @@
+#include <algorithm>
+#include <atomic>
+#include <kata/core/job_system.hpp>
 #include <kata/ecs/system.hpp>
 
 namespace kata {
-void Schedule::run_systems(SystemStage stage, Registry &reg)
+template<typename ID>
+static bool intersects(std::vector<ID> const& a, std::vector<ID> const& b)
 {
-    auto it = m_systems.find(stage);
-    if (it == m_systems.end()) {
+    for (auto id : a) {
+        if (std::find(b.begin(), b.end(), id) != b.end()) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool SystemAccess::conflicts_with(SystemAccess const& other) const
+{
+    if (m_is_exclusive || other.m_is_exclusive) {
+        return true;
+    }
+
+    return intersects(m_writes, other.m_writes)
+        || intersects(m_writes, other.m_reads)
+        || intersects(m_reads, other.m_writes)
+        || intersects(m_resource_writes, other.m_resource_writes)
+        || intersects(m_resource_writes, other.m_resource_reads)
+        || intersects(m_resource_reads, other.m_resource_writes);
+}
+
+void Schedule::build_graph(Stage& stage)
+{
+    auto count = stage.systems.size();
+
+    std::vector<SystemAccess> accesses;
+    accesses.reserve(count);
+
+    for (auto& system : stage.systems) {
+        accesses.push_back(system->access());
+    }
+
+    stage.is_exclusive.assign(count, false);
+    stage.dependents.assign(count, {});
+    stage.dependency_counts.assign(count, 0);
+
+    // Systems on either side of an exclusive one are ordered by it already,
+    // so edges only connect systems of the same run.
+    size_t run_start = 0;
+
+    for (size_t later = 0; later < count; later++) {
+        if (accesses[later].is_exclusive()) {
+            stage.is_exclusive[later] = true;
+            run_start = later + 1;
+            continue;
+        }
+
+        for (size_t earlier = run_start; earlier < later; earlier++) {
+            if (accesses[earlier].conflicts_with(accesses[later])) {
+                stage.dependents[earlier].push_back(later);
+                stage.dependency_counts[later]++;
+            }
+        }
+    }
+
+    stage.is_graph_dirty = false;
+}
+
+void Schedule::run_systems(SystemStage stage, Registry& reg)
+{
+    auto it = m_stages.find(stage);
+    if (it == m_stages.end()) {
         return;
     }
 
-    for (auto& system : it->second) {
-        system->run(reg);
+    auto& systems = it->second;
+
+    if (systems.is_graph_dirty) {
+        build_graph(systems);
+    }
+
+    auto count = systems.systems.size();
+    size_t run_start = 0;
+
+    for (size_t i = 0; i <= count; i++) {
+        if (i < count && !systems.is_exclusive[i]) {
+            continue;
+        }
+
+        run_concurrently(systems, run_start, i, reg);
+
+        // Exclusive systems may make structural changes, so they don't go
+        // through the job system at all.
+        if (i < count) {
+            systems.systems[i]->run(reg);
+        }
+
+        run_start = i + 1;
+    }
+}
+
+void Schedule::run_concurrently(Stage& stage, size_t first, size_t last, Registry& reg)
+{
+    if (last - first <= 1) {
+        if (first < last) {
+            stage.systems[first]->run(reg);
+        }
+
+        return;
+    }
+
+    auto& jobs = reg.jobs();
+
+    std::vector<std::atomic<uint32_t>> remaining(last - first);
+    for (size_t i = first; i < last; i++) {
+        remaining[i - first].store(stage.dependency_counts[i], std::memory_order_relaxed);
     }
+
+    JobCounter counter {};
+
+    // Each finished system releases its dependents; the last dependency to
+    // finish submits the dependent.
+    auto run_system = [&](auto& self, size_t index) -> void {
+        stage.systems[index]->run(reg);
+
+        for (auto dependent : stage.dependents[index]) {
+            if (remaining[dependent - first].fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                jobs.submit(counter, [&self, dependent] {
+                    self(self, dependent);
+                });
+            }
+        }
+    };
+
+    for (size_t i = first; i < last; i++) {
+        if (stage.dependency_counts[i] == 0) {
+            jobs.submit(counter, [&run_system, i] {
+                run_system(run_system, i);
+            });
+        }
+    }
+
+    jobs.wait(counter);
 }
 }
@@ -1,6 +1,8 @@
 #pragma once
 
+#include <kata/ecs/component.hpp>
 #include <kata/ecs/registry.hpp>
+#include <kata/ecs/resource.hpp>
 #include <memory>
 #include <unordered_map>
 #include <vector>
@@ -13,9 +15,92 @@ enum class SystemStage {
     AfterStep,
 };
 
+// Components and resources a system touches. Resources are identified by
+// type just like components, but by their own resource_id().
+class SystemAccess {
+public:
+    SystemAccess() = default;
+
+    // Access that conflicts with every other system, e.g. for systems making
+    // structural changes to the registry.
+    static SystemAccess exclusive()
+    {
+        SystemAccess access {};
+        access.m_is_exclusive = true;
+        return access;
+    }
+
+    template<typename... Components>
+    SystemAccess& read()
+    {
+        (m_reads.push_back(component_id<Components>()), ...);
+        return *this;
+    }
+
+    template<typename... Components>
+    SystemAccess& write()
+    {
+        (m_writes.push_back(component_id<Components>()), ...);
+        return *this;
+    }
+
+    template<typename... Resources>
+    SystemAccess& read_resource()
+    {
+        (m_resource_reads.push_back(resource_id<Resources>()), ...);
+        return *this;
+    }
+
+    template<typename... Resources>
+    SystemAccess& write_resource()
+    {
+        (m_resource_writes.push_back(resource_id<Resources>()), ...);
+        return *this;
+    }
+
+    // Sending events is safe from concurrently running systems, so it counts
+    // as a read of the channel. Reading them conflicts with the senders.
+    template<typename... T>
+    SystemAccess& send_events()
+    {
+        return read_resource<Events<T>...>();
+    }
+
+    template<typename... T>
+    SystemAccess& read_events()
+    {
+        return write_resource<Events<T>...>();
+    }
+
+    bool is_exclusive() const
+    {
+        return m_is_exclusive;
+    }
+
+    // Two systems conflict if either is exclusive or one writes something
+    // the other reads or writes.
+    bool conflicts_with(SystemAccess const& other) const;
+
+private:
+    std::vector<ComponentID> m_reads {};
+    std::vector<ComponentID> m_writes {};
+    std::vector<ResourceID> m_resource_reads {};
+    std::vector<ResourceID> m_resource_writes {};
+    bool m_is_exclusive {};
+};
+
 class System {
 public:
+    virtual ~System() = default;
+
     virtual void run(Registry& reg) = 0;
+
+    // What run() touches. Systems that don't override this are treated as
+    // exclusive and never run concurrently with anything else.
+    virtual SystemAccess access() const
+    {
+        return SystemAccess::exclusive();
+    }
 };
 
 class Schedule {
@@ -25,25 +110,37 @@ public:
     template<typename T>
     void add_system(SystemStage stage, T system)
     {
-        std::unique_ptr system_ptr(system);
-
-        auto it = m_systems.find(stage);
-        if (it == m_systems.end()) {
-            std::vector<std::unique_ptr<System>> stage_systems {
-                system_ptr,
-            };
-
-            m_systems.insert(std::make_pair(stage, std::move(stage_systems)));
+        auto& stage_systems = m_stages[stage];
 
-            return;
-        }
-
-        it->second.push_back(system_ptr);
+        stage_systems.systems.push_back(std::make_unique<T>(std::move(system)));
+        stage_systems.is_graph_dirty = true;
     }
 
+    // Runs the stage's systems on the registry's job system. Systems with
+    // conflicting access run in registration order, everything else may run
+    // concurrently. Exclusive systems run on the calling thread once every
+    // system registered before them has finished.
     void run_systems(SystemStage stage, Registry& reg);
 
 private:
-    std::unordered_map<SystemStage, std::vector<std::unique_ptr<System>>> m_systems;
+    struct Stage {
+        std::vector<std::unique_ptr<System>> systems {};
+
+        // Exclusive systems split the stage into runs of non-exclusive ones.
+        // dependents[i] lists the systems of the same run that have to wait
+        // for system i.
+        std::vector<bool> is_exclusive {};
+        std::vector<std::vector<size_t>> dependents {};
+        std::vector<uint32_t> dependency_counts {};
+        bool is_graph_dirty {};
+    };
+
+    static void build_graph(Stage& stage);
+
+    // Runs the non-exclusive systems [first, last) as jobs, each one as soon
+    // as the systems it depends on have finished.
+    static void run_concurrently(Stage& stage, size_t first, size_t last, Registry& reg);
+
+    std::unordered_map<SystemStage, Stage> m_stages;
 };
 }
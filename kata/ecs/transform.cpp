@@ -0,0 +1,91 @@
+#include <algorithm>
+#include <kata/core/job_system.hpp>
+#include <kata/ecs/transform.hpp>
+
+namespace kata {
+void TransformPropagationSystem::run(Registry& reg)
+{
+    for (auto& level : m_levels) {
+        level.clear();
+    }
+
+    // Roots have nothing to wait for: their global transform is the local one.
+    // Writing only the ones that differ keeps Changed<GlobalTransform> quiet.
+    reg.query<Entity, LocalTransform const, GlobalTransform const, Optional<Children const>, Without<Parent>>(
+        [&](EntityID id, LocalTransform const& local, GlobalTransform const& global, Children const* children) {
+            if (global.value == local.value) {
+                return;
+            }
+
+            reg.get<GlobalTransform>(id).value = local.value;
+
+            if (children) {
+                push_children(*children, 1);
+            }
+        });
+
+    auto push_dirty = [&](EntityID id, Parent const& parent) {
+        push(id, parent.depth);
+    };
+
+    // Tracked per run rather than per tick, so writes made after this
+    // system ran in the previous frame aren't missed.
+    auto ticks = reg.track_changes(m_changes);
+
+    reg.query<Entity, Parent const, Changed<LocalTransform>>(ticks, push_dirty);
+    reg.query<Entity, Parent const, Changed<Parent>>(ticks, push_dirty);
+
+    for (size_t depth = 1; depth < m_levels.size(); depth++) {
+        auto& level = m_levels[depth];
+
+        if (level.empty()) {
+            continue;
+        }
+
+        // An entity can be dirty itself and sit under a dirty ancestor.
+        std::sort(level.begin(), level.end());
+        level.erase(std::unique(level.begin(), level.end()), level.end());
+
+        reg.jobs().parallel_for(level.size(), m_grain_size, [&](size_t begin, size_t end) {
+            for (auto i = begin; i < end; i++) {
+                auto id = level[i];
+                auto local = reg.try_get<LocalTransform const>(id);
+                auto parent_global = reg.try_get<GlobalTransform const>(reg.get<Parent const>(id).entity);
+
+                if (!local || !parent_global) {
+                    continue;
+                }
+
+                if (auto global = reg.try_get<GlobalTransform>(id)) {
+                    global->value = parent_global->value * local->value;
+                }
+            }
+        });
+
+        for (size_t i = 0; i < m_levels[depth].size(); i++) {
+            if (auto children = reg.try_get<Children const>(m_levels[depth][i])) {
+                push_children(*children, uint32_t(depth + 1));
+            }
+        }
+    }
+}
+
+void TransformPropagationSystem::push(EntityID id, uint32_t depth)
+{
+    if (depth >= m_levels.size()) {
+        m_levels.resize(depth + 1);
+    }
+
+    m_levels[depth].push_back(id);
+}
+
+void TransformPropagationSystem::push_children(Children const& children, uint32_t depth)
+{
+    if (depth >= m_levels.size()) {
+        m_levels.resize(depth + 1);
+    }
+
+    auto& level = m_levels[depth];
+    level.insert(level.end(), children.entities.begin(), children.entities.end());
+}
+}
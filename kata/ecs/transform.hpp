@@ -0,0 +1,56 @@
+#pragma once
+
+#include <kata/core/math.hpp>
+#include <kata/ecs/system.hpp>
+#include <vector>
+
+namespace kata {
+// Transform relative to the parent, or to the world for roots.
+struct LocalTransform {
+    Transform value {};
+};
+
+// World-space transform, written by TransformPropagationSystem.
+struct GlobalTransform {
+    Transform value {};
+};
+
+// Computes GlobalTransform from LocalTransform down the Parent/Children
+// hierarchy.
+//
+// Only dirty subtrees are visited: those under entities whose LocalTransform
+// or Parent changed since the system's previous run, and under roots whose
+// global transform ended up different. Dirty entities are bucketed by
+// Parent::depth and processed one level at a time; all entities of a level
+// only read the level above, so each level is computed in parallel.
+class TransformPropagationSystem : public System {
+public:
+    // Levels smaller than this are computed on the calling thread.
+    static constexpr size_t default_grain_size = 256;
+
+    explicit TransformPropagationSystem(size_t grain_size = default_grain_size)
+        : m_grain_size(grain_size)
+    {
+    }
+
+    virtual void run(Registry& reg) override;
+
+    virtual SystemAccess access() const override
+    {
+        return SystemAccess {}
+            .read<LocalTransform, Parent, Children>()
+            .write<GlobalTransform>();
+    }
+
+private:
+    void push(EntityID id, uint32_t depth);
+    void push_children(Children const& children, uint32_t depth);
+
+    size_t m_grain_size {};
+    ChangeTracker m_changes {};
+
+    // m_levels[d] holds the dirty entities at depth d; kept between runs to
+    // avoid reallocating.
+    std::vector<std::vector<EntityID>> m_levels {};
+};
+}
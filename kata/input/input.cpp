@@ -11,6 +11,8 @@ bool InputHandler::is_key_pressed(Key key) const
 
 void InputHandler::submit_key_event(KeyEvent event)
 {
+    m_events.push_back(event);
+
     switch (event.action) {
     case GLFW_PRESS:
         m_pressed_keys.insert(event.scancode);
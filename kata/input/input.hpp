@@ -3,7 +3,9 @@
 #include <GLFW/glfw3.h>
 #include <kata/input/key.hpp>
 #include <kata/render/window.hpp>
+#include <span>
 #include <unordered_set>
+#include <vector>
 
 namespace kata {
 using Scancode = int;
@@ -28,11 +30,20 @@ public:
     bool is_key_pressed(Key key) const;
     void submit_key_event(KeyEvent event);
 
-    void events_in_this_frame();
+    // Key events submitted since the last flush_events().
+    std::span<KeyEvent const> events_in_this_frame() const
+    {
+        return m_events;
+    }
 
-    void flush_events();
+    // Called once per frame; keeps the storage for the next one.
+    void flush_events()
+    {
+        m_events.clear();
+    }
 
 private:
     std::unordered_set<Scancode> m_pressed_keys {};
+    std::vector<KeyEvent> m_events {};
 };
 }